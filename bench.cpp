@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#define WEBGPU_CPP_IMPLEMENTATION
+#ifndef WEBGPU_CPP_IMPLEMENTATION
+// Removes unsused macro warning for WEBGPU_CPP_IMPLEMENTATION
+#endif
+
+#include <webgpu/webgpu.hpp>
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_LEFT_HANDED
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include <wga/wga.hpp>
+#include <wga/benchmark.hpp>
+#include <wga/setup.hpp>
+#include <wga/model.hpp>
+#include <wga/geometry/synthetic.hpp>
+#include <wga/image_processing.hpp>
+#include <wga/culling.hpp>
+#include <wga/bvh.hpp>
+
+// Microbenchmarks of the loaders, uploads and frame submission on synthetic data of increasing size
+namespace {
+    struct bench_result {
+        std::string name;
+        std::size_t items;
+        std::string unit; // what items count
+        std::size_t runs;
+        wga::frame_time_summary time; // ms per run
+    };
+
+    struct bench_runner {
+        double min_time{0.5}; // seconds spent per benchmark after one warm-up run
+        std::size_t min_runs{5};
+        std::vector<bench_result> results;
+
+        // unit names what items count, e.g. bytes for parsers so the rate reads as MB/s
+        void run(const std::string &name, std::size_t items, const std::function<void()> &task,
+                 const std::string &unit = "items") {
+            task();
+
+            std::vector<double> times;
+            const auto start = std::chrono::steady_clock::now();
+            while (times.size() < min_runs ||
+                   std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < min_time) {
+                const auto run_start = std::chrono::steady_clock::now();
+                task();
+                times.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - run_start).count());
+            }
+
+            const auto &result = results.emplace_back(
+                    bench_result{name, items, unit, times.size(), wga::summarize_frame_times(times)});
+            std::cout << std::left << std::setw(44) << result.name << std::right << std::fixed
+                      << std::setprecision(3) << std::setw(12) << result.time.p50 << " ms p50"
+                      << std::setw(12) << result.time.min << " ms min"
+                      << std::setw(14) << std::setprecision(1)
+                      << static_cast<double>(items) / (result.time.p50 / 1000.0) / 1e6 << " M " << unit << "/s\n";
+        }
+
+        bool write_json(const std::filesystem::path &path) const {
+            std::ofstream stream(path);
+            if (!stream) {
+                std::cerr << "Could not write benchmark results to " << path.string() << '\n';
+                return false;
+            }
+
+            stream << std::setprecision(6) << "[\n";
+            for (std::size_t i = 0; i < results.size(); ++i) {
+                const auto &result = results[i];
+                stream << "  {\"name\": \"" << result.name << "\", \"items\": " << result.items
+                       << ", \"unit\": \"" << result.unit << '"'
+                       << ", \"runs\": " << result.runs << ", \"min_ms\": " << result.time.min
+                       << ", \"p50_ms\": " << result.time.p50 << ", \"p95_ms\": " << result.time.p95
+                       << ", \"max_ms\": " << result.time.max << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+            }
+            stream << "]\n";
+            return static_cast<bool>(stream);
+        }
+    };
+
+    void bench_loaders(bench_runner &runner, const std::filesystem::path &directory,
+                       const std::vector<std::size_t> &triangle_counts) {
+        for (auto triangle_count: triangle_counts) {
+            const auto mesh = wga::geometry::make_grid_mesh(triangle_count);
+            const auto suffix = " " + std::to_string(triangle_count) + " tris";
+
+            const auto points_path = directory / ("grid_" + std::to_string(triangle_count) + ".txt");
+            wga::geometry::write_points(points_path, mesh, 3);
+            runner.run("geometry::load" + suffix, triangle_count, [&points_path] {
+                std::vector<float> point_data;
+                std::vector<std::uint32_t> index_data;
+                wga::geometry::load(points_path, point_data, index_data, 3);
+            });
+
+            const auto obj_path = directory / ("grid_" + std::to_string(triangle_count) + ".obj");
+            wga::geometry::write_obj(obj_path, mesh);
+            runner.run("geometry::load_obj" + suffix, triangle_count, [&obj_path] {
+                std::vector<wga::shader_type::vertex_attributes> vertex_data;
+                std::vector<std::uint32_t> index_data;
+                wga::geometry::load_obj(obj_path, vertex_data, index_data);
+            });
+
+            // Parsing alone against tinyobj on the same file, items are bytes
+            const auto obj_size = static_cast<std::size_t>(std::filesystem::file_size(obj_path));
+            runner.run("geometry::parse_obj" + suffix, obj_size, [&obj_path] {
+                wga::geometry::obj_data data;
+                wga::geometry::parse_obj(obj_path, data);
+            }, "bytes");
+            runner.run("tinyobj::LoadObj" + suffix, obj_size, [&obj_path] {
+                tinyobj::attrib_t attrib;
+                std::vector<tinyobj::shape_t> shapes;
+                wga::geometry::read_obj_tinyobj(obj_path, attrib, shapes);
+            }, "bytes");
+        }
+    }
+
+    // CPU texture baking, square images, items are source pixels
+    void bench_images(bench_runner &runner, const std::vector<std::uint32_t> &image_sizes) {
+        wga::thread_pool pool;
+        for (auto size: image_sizes) {
+            const auto suffix = " " + std::to_string(size) + "x" + std::to_string(size);
+            const std::size_t pixel_count = std::size_t{size} * size;
+
+            std::vector<std::uint8_t> rgb(3 * pixel_count);
+            for (std::size_t i = 0; i < rgb.size(); ++i) {
+                rgb[i] = static_cast<std::uint8_t>(i * 7);
+            }
+            runner.run("image::convert_rgb_to_rgba" + suffix, pixel_count, [&] {
+                wga::convert_rgb_to_rgba(&pool, rgb.data(), size, size);
+            });
+
+            const auto image = wga::convert_rgb_to_rgba(&pool, rgb.data(), size, size);
+            runner.run("image::premultiply_alpha" + suffix, pixel_count, [&] {
+                auto copy = image;
+                wga::premultiply_alpha(&pool, copy);
+            });
+            runner.run("image::to_linear" + suffix, pixel_count, [&] {
+                wga::to_linear(&pool, image);
+            });
+            runner.run("image::generate_mip_chain box" + suffix, pixel_count, [&] {
+                wga::generate_mip_chain(&pool, image, wga::mip_filter::box);
+            });
+            runner.run("image::generate_mip_chain kaiser" + suffix, pixel_count, [&] {
+                wga::generate_mip_chain(&pool, image, wga::mip_filter::kaiser);
+            });
+            for (const auto &[name, format]: {std::pair{"bc1", wga::block_format::bc1},
+                                              std::pair{"bc3", wga::block_format::bc3},
+                                              std::pair{"bc5", wga::block_format::bc5},
+                                              std::pair{"bc7", wga::block_format::bc7}}) {
+                runner.run(std::string("image::compress_image ") + name + suffix, pixel_count, [&] {
+                    wga::compress_image(&pool, image, format);
+                });
+            }
+        }
+    }
+
+    // Frustum culling of an object grid of which the frustum holds about a quarter, items are objects
+    void bench_culling(bench_runner &runner, const std::vector<std::size_t> &cull_counts) {
+        wga::thread_pool pool;
+        const auto frustum = wga::get_frustum(glm::scale(glm::mat4x4(1.0f), glm::vec3(2.0f, 2.0f, 1.0f)));
+        const wga::geometry::bounds bounds{glm::vec3(-1.0f), glm::vec3(1.0f)};
+        std::vector<std::uint32_t> visible;
+        for (auto cull_count: cull_counts) {
+            const auto suffix = " " + std::to_string(cull_count) + " objects";
+            const auto transforms = wga::geometry::make_object_grid(cull_count);
+
+            wga::cull_bounds cull_bounds;
+            cull_bounds.resize(cull_count);
+            runner.run("cull_bounds::set" + suffix, cull_count, [&] {
+                for (std::size_t i = 0; i < cull_count; ++i) {
+                    cull_bounds.set(i, transforms[i], bounds, std::sqrt(3.0f));
+                }
+            });
+            runner.run("cull scalar" + suffix, cull_count, [&] {
+                visible.clear();
+                wga::cull_scalar(frustum, cull_bounds, 0, cull_bounds.count, visible);
+            });
+            runner.run("cull simd" + suffix, cull_count, [&] {
+                wga::cull(nullptr, frustum, cull_bounds, visible);
+            });
+            runner.run("cull simd parallel" + suffix, cull_count, [&] {
+                wga::cull(&pool, frustum, cull_bounds, visible);
+            });
+        }
+    }
+
+    // BVH over the same object grid: builds, a refit, hierarchical culling and picking with rays down the z axis
+    void bench_bvh(bench_runner &runner, const std::vector<std::size_t> &cull_counts) {
+        static constexpr std::size_t ray_count = 1024;
+        wga::thread_pool pool;
+        const auto frustum = wga::get_frustum(glm::scale(glm::mat4x4(1.0f), glm::vec3(2.0f, 2.0f, 1.0f)));
+        const wga::geometry::bounds bounds{glm::vec3(-1.0f), glm::vec3(1.0f)};
+        std::vector<std::uint32_t> visible;
+        for (auto cull_count: cull_counts) {
+            const auto suffix = " " + std::to_string(cull_count) + " objects";
+            const auto transforms = wga::geometry::make_object_grid(cull_count);
+            std::vector<wga::geometry::bounds> world_bounds(cull_count);
+            for (std::size_t i = 0; i < cull_count; ++i) {
+                world_bounds[i] = wga::geometry::transform_bounds(transforms[i], bounds);
+            }
+
+            runner.run("build_bvh" + suffix, cull_count, [&] {
+                wga::build_bvh(nullptr, world_bounds);
+            });
+            runner.run("build_bvh parallel" + suffix, cull_count, [&] {
+                wga::build_bvh(&pool, world_bounds);
+            });
+            auto bvh = wga::build_bvh(&pool, world_bounds);
+            runner.run("refit_bvh" + suffix, cull_count, [&] {
+                wga::refit_bvh(bvh, world_bounds);
+            });
+            runner.run("cull_bvh" + suffix, cull_count, [&] {
+                wga::cull_bvh(frustum, bvh, world_bounds, visible);
+            });
+            // Items are rays
+            std::size_t hits = 0;
+            runner.run("intersect_bvh" + suffix, ray_count, [&] {
+                for (std::size_t i = 0; i < ray_count; ++i) {
+                    const auto &center = transforms[i * cull_count / ray_count][3];
+                    const wga::ray ray{glm::vec3(center.x, center.y, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f)};
+                    hits += wga::intersect_bvh(bvh, world_bounds, ray).has_value();
+                }
+            });
+            if (hits == 0) {
+                std::cerr << "intersect_bvh" << suffix << " missed every object\n";
+            }
+        }
+    }
+
+    void bench_uploads(bench_runner &runner, wga::context &context, const std::vector<std::size_t> &triangle_counts) {
+        for (auto triangle_count: triangle_counts) {
+            const auto mesh = wga::geometry::make_grid_mesh(triangle_count);
+            const auto suffix = " " + std::to_string(triangle_count) + " tris";
+
+            const auto point_data = wga::geometry::make_point_data(mesh, 3);
+            wga::geometry::mesh_header point_header{};
+            point_header.vertex_stride = 6 * sizeof(float);
+            point_header.index_count = mesh.indices.size();
+            point_header.vertex_size = wga::bytesize(point_data);
+            point_header.index_size = wga::bytesize(mesh.indices);
+            runner.run("create_model" + suffix, triangle_count, [&] {
+                auto model = wga::create_model(context, point_header, point_data.data(), mesh.indices.data());
+                context.staging_belt.flush(context.device, context.queue);
+                wga::poll(context.device, true);
+            });
+
+            const auto vertex_data = wga::geometry::make_vertex_attributes(mesh);
+            const auto bounds = wga::geometry::compute_bounds(vertex_data);
+            for (const auto &[format_name, format]: {std::pair{"full", wga::full_vertex_format},
+                                                     std::pair{"compact", wga::compact_vertex_format}}) {
+                const auto encoded = wga::encode_vertices(format, vertex_data, bounds.min, bounds.max);
+                wga::geometry::mesh_header header{};
+                header.index_format = wga::geometry::mesh_index_format::uint32;
+                header.index_count = mesh.indices.size();
+                header.vertex_size = encoded.size();
+                header.index_size = wga::bytesize(mesh.indices);
+                runner.run(std::string("create_model_obj ") + format_name + suffix, triangle_count, [&] {
+                    auto model = wga::create_model_obj(context, header, encoded.data(), mesh.indices.data(), format);
+                    context.staging_belt.flush(context.device, context.queue);
+                    wga::poll(context.device, true);
+                });
+            }
+        }
+    }
+
+    // Dynamic geometry streamed into one vertex buffer every run, in 64 KiB updates
+    void bench_streaming(bench_runner &runner, wga::context &context, const std::vector<std::size_t> &upload_sizes) {
+        static constexpr std::size_t update_size = 1 << 16;
+        for (auto upload_size: upload_sizes) {
+            const std::vector<std::byte> data(upload_size);
+            auto buffer = wga::create_buffer(context.device, upload_size,
+                                             wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex);
+            const auto suffix = " " + std::to_string(upload_size >> 20) + " MiB";
+
+            runner.run("stream writeBuffer" + suffix, upload_size, [&] {
+                for (std::size_t offset = 0; offset < upload_size; offset += update_size) {
+                    context.queue.get().writeBuffer(buffer.get(), offset, data.data() + offset,
+                                                    std::min(update_size, upload_size - offset));
+                }
+                wga::poll(context.device, false);
+            });
+
+            runner.run("stream staging belt" + suffix, upload_size, [&] {
+                for (std::size_t offset = 0; offset < upload_size; offset += update_size) {
+                    context.staging_belt.write_buffer(context.device, buffer.get(), offset, data.data() + offset,
+                                                      std::min(update_size, upload_size - offset));
+                }
+                context.staging_belt.flush(context.device, context.queue);
+                wga::poll(context.device, false);
+            });
+        }
+    }
+
+    struct frame_resources {
+        wga::texture texture;
+        wga::object<wgpu::Sampler> sampler;
+        wga::object<wgpu::BindGroup> bind_group;
+    };
+
+    auto create_frame_resources(wga::context &context) -> frame_resources {
+        auto texture = wga::create_texture(context.device, 1, 1, 1);
+        auto sampler = wga::create_sampler(context.device, texture.mip_level_count);
+        auto bind_group = wga::create_bind_group(context, texture, sampler);
+        return frame_resources{std::move(texture), std::move(sampler), std::move(bind_group)};
+    }
+
+    // Packs and uploads one uniform block per object, returns the dynamic offsets
+    void update_uniforms(wga::context &context, const std::vector<glm::mat4x4> &transforms,
+                         std::vector<std::uint32_t> &dynamic_offsets) {
+        wga::shader_type::uniforms uniforms{glm::mat4x4(1.0f), glm::mat4x4(1.0f), glm::mat4x4(1.0f),
+                                            glm::vec4(1.0f), 0.0f};
+        context.uniform_ring.begin_frame(context.device);
+        dynamic_offsets.clear();
+        for (const auto &transform: transforms) {
+            uniforms.model_matrix = transform;
+            dynamic_offsets.push_back(context.uniform_ring.push(uniforms));
+        }
+        context.uniform_ring.upload(context.device, context.staging_belt, context.uniform_buffer);
+    }
+
+    void encode_frame(wga::context &context, frame_resources &resources, wga::model_obj &model,
+                      const std::vector<std::uint32_t> &dynamic_offsets) {
+        auto color_view = wga::acquire_color_view(context);
+        auto &depth_target = wga::acquire_depth_target(context);
+
+        wgpu::CommandEncoderDescriptor encoder_descriptor = {};
+        encoder_descriptor.label = "Benchmark encoder";
+        auto encoder = wga::object{context.device.get().createCommandEncoder(encoder_descriptor)};
+        context.staging_belt.encode(encoder.get());
+
+        wgpu::RenderPassColorAttachment color_attachment = {};
+        color_attachment.view = color_view.get();
+        color_attachment.resolveTarget = nullptr;
+        color_attachment.loadOp = WGPULoadOp_Clear;
+        color_attachment.storeOp = WGPUStoreOp_Store;
+        color_attachment.clearValue = wgpu::Color{0.0, 0.0, 0.0, 1.0};
+
+        wgpu::RenderPassDepthStencilAttachment depth_attachment;
+        depth_attachment.view = depth_target.view.get();
+        depth_attachment.depthClearValue = 1.0f;
+        depth_attachment.depthLoadOp = wgpu::LoadOp::Clear;
+        depth_attachment.depthStoreOp = wgpu::StoreOp::Store;
+        depth_attachment.depthReadOnly = false;
+        depth_attachment.stencilClearValue = 0;
+        depth_attachment.stencilLoadOp = wgpu::LoadOp::Clear;
+        depth_attachment.stencilStoreOp = wgpu::StoreOp::Store;
+        depth_attachment.stencilReadOnly = true;
+
+        wgpu::RenderPassDescriptor render_pass_desc = {};
+        render_pass_desc.colorAttachmentCount = 1;
+        render_pass_desc.colorAttachments = &color_attachment;
+        render_pass_desc.depthStencilAttachment = &depth_attachment;
+        render_pass_desc.timestampWriteCount = 0;
+        render_pass_desc.timestampWrites = nullptr;
+        auto render_pass = wga::object{encoder.get().beginRenderPass(render_pass_desc)};
+
+        render_pass.get().setPipeline(context.pipeline);
+        wga::mesh_bindings mesh_bindings;
+        for (auto dynamic_offset: dynamic_offsets) {
+            render_pass.get().setBindGroup(0, resources.bind_group.get(), 1, &dynamic_offset);
+            wga::draw(render_pass.get(), model, mesh_bindings);
+        }
+        render_pass.get().end();
+
+        wgpu::CommandBufferDescriptor command_buffer_desc = {};
+        command_buffer_desc.label = "Benchmark command buffer";
+        auto command = wga::object{encoder.get().finish(command_buffer_desc)};
+        context.queue.get().submit(1, &command.get());
+        context.staging_belt.recall();
+        context.uniform_ring.end_frame(context.queue);
+    }
+
+    // Position stream of a mesh, drawn by the depth pipeline
+    struct depth_mesh {
+        wga::object<wgpu::Buffer, true> position_buffer;
+        wga::object<wgpu::Buffer, true> index_buffer;
+        std::uint64_t position_size;
+        std::uint64_t index_size;
+        std::uint32_t index_count;
+    };
+
+    void encode_depth_prepass(wga::context &context, frame_resources &resources, wgpu::RenderPipeline pipeline,
+                              depth_mesh &mesh, const std::vector<std::uint32_t> &dynamic_offsets) {
+        auto &depth_target = wga::acquire_depth_target(context);
+
+        wgpu::CommandEncoderDescriptor encoder_descriptor = {};
+        encoder_descriptor.label = "Depth prepass encoder";
+        auto encoder = wga::object{context.device.get().createCommandEncoder(encoder_descriptor)};
+        context.staging_belt.encode(encoder.get());
+
+        wgpu::RenderPassDepthStencilAttachment depth_attachment;
+        depth_attachment.view = depth_target.view.get();
+        depth_attachment.depthClearValue = 1.0f;
+        depth_attachment.depthLoadOp = wgpu::LoadOp::Clear;
+        depth_attachment.depthStoreOp = wgpu::StoreOp::Store;
+        depth_attachment.depthReadOnly = false;
+        depth_attachment.stencilClearValue = 0;
+        depth_attachment.stencilLoadOp = wgpu::LoadOp::Clear;
+        depth_attachment.stencilStoreOp = wgpu::StoreOp::Store;
+        depth_attachment.stencilReadOnly = true;
+
+        wgpu::RenderPassDescriptor render_pass_desc = {};
+        render_pass_desc.colorAttachmentCount = 0;
+        render_pass_desc.colorAttachments = nullptr;
+        render_pass_desc.depthStencilAttachment = &depth_attachment;
+        render_pass_desc.timestampWriteCount = 0;
+        render_pass_desc.timestampWrites = nullptr;
+        auto render_pass = wga::object{encoder.get().beginRenderPass(render_pass_desc)};
+
+        render_pass.get().setPipeline(pipeline);
+        render_pass.get().setVertexBuffer(0, mesh.position_buffer.get(), 0, mesh.position_size);
+        render_pass.get().setIndexBuffer(mesh.index_buffer.get(), wgpu::IndexFormat::Uint32, 0,
+                                         mesh.index_size);
+        for (auto dynamic_offset: dynamic_offsets) {
+            render_pass.get().setBindGroup(0, resources.bind_group.get(), 1, &dynamic_offset);
+            render_pass.get().drawIndexed(mesh.index_count, 1, 0, 0, 0);
+        }
+        render_pass.get().end();
+
+        wgpu::CommandBufferDescriptor command_buffer_desc = {};
+        command_buffer_desc.label = "Depth prepass command buffer";
+        auto command = wga::object{encoder.get().finish(command_buffer_desc)};
+        context.queue.get().submit(1, &command.get());
+        context.staging_belt.recall();
+        context.uniform_ring.end_frame(context.queue);
+    }
+
+    void bench_frames(bench_runner &runner, wga::context &context, const std::vector<std::size_t> &object_counts) {
+        auto resources = create_frame_resources(context);
+
+        const auto mesh = wga::geometry::make_grid_mesh(2);
+        const auto vertex_data = wga::geometry::make_vertex_attributes(mesh);
+        wga::geometry::mesh_header header{};
+        header.index_format = wga::geometry::mesh_index_format::uint32;
+        header.index_count = mesh.indices.size();
+        header.vertex_size = wga::bytesize(vertex_data);
+        header.index_size = wga::bytesize(mesh.indices);
+        auto model = wga::create_model_obj(context, header, vertex_data.data(), mesh.indices.data(),
+                                           wga::full_vertex_format);
+
+        // The depth prepass reads 12 bytes per vertex from the position stream instead of the interleaved 44
+        const auto positions = wga::split_vertex_streams(vertex_data).first;
+        depth_mesh depth_model{
+                wga::create_buffer_init(context.device, positions.data(), wga::bytesize(positions),
+                                        wgpu::BufferUsage::Vertex),
+                wga::create_buffer_init(context.device, mesh.indices.data(), header.index_size,
+                                        wgpu::BufferUsage::Index),
+                wga::bytesize(positions),
+                header.index_size,
+                static_cast<std::uint32_t>(mesh.indices.size())};
+        const auto depth_pipeline = wga::create_depth_pipeline(context.pipelines, context.device,
+                                                               context.bind_group_layout,
+                                                               context.depth_texture_format);
+
+        std::vector<std::uint32_t> dynamic_offsets;
+        for (auto object_count: object_counts) {
+            const auto transforms = wga::geometry::make_object_grid(object_count);
+            const auto suffix = " " + std::to_string(object_count) + " objects";
+
+            runner.run("uniform update+flush" + suffix, object_count, [&] {
+                update_uniforms(context, transforms, dynamic_offsets);
+                context.staging_belt.flush(context.device, context.queue);
+            });
+
+            runner.run("frame encode+submit" + suffix, object_count, [&] {
+                context.render_targets.begin_frame();
+                update_uniforms(context, transforms, dynamic_offsets);
+                encode_frame(context, resources, model, dynamic_offsets);
+            });
+
+            runner.run("frame encode+submit+wait" + suffix, object_count, [&] {
+                context.render_targets.begin_frame();
+                update_uniforms(context, transforms, dynamic_offsets);
+                encode_frame(context, resources, model, dynamic_offsets);
+                wga::poll(context.device, true);
+            });
+
+            runner.run("depth prepass encode+submit+wait" + suffix, object_count, [&] {
+                context.render_targets.begin_frame();
+                update_uniforms(context, transforms, dynamic_offsets);
+                encode_depth_prepass(context, resources, depth_pipeline, depth_model, dynamic_offsets);
+                wga::poll(context.device, true);
+            });
+
+            runner.run("frame encode+submit+readback" + suffix, object_count, [&] {
+                context.render_targets.begin_frame();
+                update_uniforms(context, transforms, dynamic_offsets);
+                encode_frame(context, resources, model, dynamic_offsets);
+                const auto pixels = wga::read_color_target(context);
+                if (pixels.size() != std::size_t{4} * context.width * context.height) {
+                    throw std::runtime_error("Color target readback has the wrong size");
+                }
+            });
+        }
+    }
+}
+
+// wga_bench [--quick] [--output=file]
+int main(int argc, char **argv) {
+    bool quick = false;
+    std::filesystem::path output = "bench.json";
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--quick") {
+            quick = true;
+        } else if (argument.substr(0, 9) == "--output=") {
+            output = std::string(argument.substr(9));
+        } else {
+            std::cerr << "Unknown argument " << argument << "\nUsage: wga_bench [--quick] [--output=file]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::vector<std::size_t> triangle_counts = quick ? std::vector<std::size_t>{1000, 100000}
+                                                           : std::vector<std::size_t>{1000, 100000, 1000000};
+    const std::vector<std::size_t> upload_sizes = quick ? std::vector<std::size_t>{1 << 20}
+                                                        : std::vector<std::size_t>{1 << 20, 16 << 20};
+    const std::vector<std::uint32_t> image_sizes = quick ? std::vector<std::uint32_t>{1024}
+                                                         : std::vector<std::uint32_t>{1024, 4096};
+    const std::vector<std::size_t> cull_counts = quick ? std::vector<std::size_t>{10000, 100000}
+                                                       : std::vector<std::size_t>{10000, 100000, 1000000};
+    const std::vector<std::size_t> object_counts = quick ? std::vector<std::size_t>{1000, 5000}
+                                                         : std::vector<std::size_t>{1000, 5000, 20000};
+
+    try {
+        bench_runner runner;
+        if (quick) {
+            runner.min_time = 0.1;
+            runner.min_runs = 3;
+        }
+
+        const auto directory = std::filesystem::temp_directory_path() / "wga_bench";
+        std::filesystem::create_directories(directory);
+        bench_loaders(runner, directory, triangle_counts);
+        bench_images(runner, image_sizes);
+        bench_culling(runner, cull_counts);
+        bench_bvh(runner, cull_counts);
+
+        // The GPU part runs on a headless device, software adapters included
+        std::optional<wga::context> context;
+        try {
+            context.emplace(wga::setup_headless(640, 480, static_cast<std::uint32_t>(object_counts.back())));
+        } catch (const std::exception &exception) {
+            std::cerr << "Skipping GPU benchmarks: " << exception.what() << '\n';
+        }
+        if (context) {
+            bench_uploads(runner, *context, triangle_counts);
+            bench_streaming(runner, *context, upload_sizes);
+            bench_frames(runner, *context, object_counts);
+        }
+
+        std::filesystem::remove_all(directory);
+        if (runner.write_json(output)) {
+            std::clog << "Wrote benchmark results to " << output.string() << '\n';
+        }
+    } catch (const std::exception &exception) {
+        std::cerr << "Exception: " << exception.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
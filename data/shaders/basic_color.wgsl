@@ -5,17 +5,24 @@ struct uniforms
     model_matrix: mat4x4f,
     color: vec4f,
     time: f32,
+    texture_layer: u32,
+    position_offset: vec4f,
+    position_scale: vec4f,
 };
 
 @group(0) @binding(0) var<uniform> us: uniforms;
-@group(0) @binding(1) var gradient_texture: texture_2d<f32>;
+// One layer per material, the layer comes from us.texture_layer or instance.texture_layer, see wga::material_textures
+@group(0) @binding(1) var material_textures: texture_2d_array<f32>;
+@group(0) @binding(2) var texture_sampler: sampler;
 
-struct vertex_input
+// vertex_input, instance_input and decode_vertex(in: vertex_input) -> vertex are generated for the
+// model's vertex format and prepended to this file, see wga::get_vertex_input_source
+struct vertex
 {
-    @location(0) position: vec3f,
-    @location(1) normal: vec3f,
-    @location(2) color: vec3f,
-    @location(3) uv: vec2f,
+    position: vec3f,
+    normal: vec3f,
+    color: vec3f,
+    uv: vec2f,
 };
 
 struct vertex_output
@@ -24,40 +31,76 @@ struct vertex_output
     @location(0) color: vec3f,
     @location(1) normal: vec3f,
     @location(2) uv: vec2f,
+    @location(3) @interpolate(flat) texture_layer: u32,
 };
 
 @vertex
 fn vs_main(in: vertex_input) -> vertex_output
 {
+    let v = decode_vertex(in);
     let M = us.projection_matrix * us.view_matrix * us.model_matrix;
     var out: vertex_output;
-    out.position = us.projection_matrix * us.view_matrix * us.model_matrix * vec4f(in.position, 1.0);
-    out.normal = (us.model_matrix * vec4f(in.normal, 0.0)).xyz;
-    out.color = in.color;
-    out.uv = in.uv;
+    out.position = us.projection_matrix * us.view_matrix * us.model_matrix * vec4f(v.position, 1.0);
+    out.normal = (us.model_matrix * vec4f(v.normal, 0.0)).xyz;
+    out.color = v.color;
+    out.uv = v.uv;
+    out.texture_layer = us.texture_layer;
 	return out;
 }
 
-@fragment
-fn fs_main(in: vertex_output) -> @location(0) vec4f
+@vertex
+fn vs_instanced(in: vertex_input, instance: instance_input) -> vertex_output
 {
-    let normal = normalize(in.normal);
-
-    let light_source_1 = vec3f(0.5, -0.9, 0.1);
-    let light_color_1 = vec3f(1.0, 0.9, 0.6);
-    let shading_1 = max(0.0, dot(light_source_1, normal)) * light_color_1;
+    let v = decode_vertex(in);
+    let model_matrix = mat4x4f(instance.model_matrix_0, instance.model_matrix_1,
+                               instance.model_matrix_2, instance.model_matrix_3);
+    var out: vertex_output;
+    out.position = us.projection_matrix * us.view_matrix * model_matrix * vec4f(v.position, 1.0);
+    out.normal = (model_matrix * vec4f(v.normal, 0.0)).xyz;
+    out.color = v.color * instance.color.rgb;
+    out.uv = v.uv;
+    out.texture_layer = instance.texture_layer;
+    return out;
+}
 
-    let light_source_2 = vec3f(0.2, 0.4, 0.3);
-    let light_color_2 = vec3f(0.6, 0.9, 1.0);
-    let shading_2 = max(0.0, dot(light_source_2, normal)) * light_color_2;
+// use_lighting, use_texture, use_vertex_color and light_count are override constants declared per pipeline, see
+// wga::get_shader_constants, disabled paths are removed when the pipeline is compiled
+const light_directions = array<vec3f, 4>(
+    vec3f(0.5, -0.9, 0.1),
+    vec3f(0.2, 0.4, 0.3),
+    vec3f(-0.6, 0.3, -0.5),
+    vec3f(0.0, 0.8, -0.2),
+);
 
-    //let color = in.color * us.color.rgb;
-    let shading = shading_1 + shading_2;
+const light_colors = array<vec3f, 4>(
+    vec3f(1.0, 0.9, 0.6),
+    vec3f(0.6, 0.9, 1.0),
+    vec3f(0.4, 0.4, 0.5),
+    vec3f(0.3, 0.3, 0.3),
+);
 
-    let texel_coords = vec2i(in.uv * vec2f(textureDimensions(gradient_texture)));
+@fragment
+fn fs_main(in: vertex_output) -> @location(0) vec4f
+{
+    var color = vec3f(1.0);
+    if (use_vertex_color) {
+        color *= in.color;
+    }
+    if (use_texture) {
+        color *= textureSample(material_textures, texture_sampler, in.uv, in.texture_layer).rgb;
+    }
+    if (use_lighting) {
+        let normal = normalize(in.normal);
+        // Copied to function variables so they can be indexed by the loop counter
+        var directions = light_directions;
+        var colors = light_colors;
+        var shading = vec3f(0.0);
+        for (var i = 0u; i < light_count; i++) {
+            shading += max(0.0, dot(directions[i], normal)) * colors[i];
+        }
+        color *= shading;
+    }
 
-    //let color = in.color * shading;
-    let color = textureLoad(gradient_texture, texel_coords, 0).rgb;
     let linear_color = pow(color, vec3f(2.2));
     return vec4f(linear_color, us.color.a);
 }
@@ -0,0 +1,21 @@
+// Same layout as the uniforms of basic_color.wgsl, only the matrices are read
+struct uniforms
+{
+    projection_matrix: mat4x4f,
+    view_matrix: mat4x4f,
+    model_matrix: mat4x4f,
+    color: vec4f,
+    time: f32,
+    texture_layer: u32,
+    position_offset: vec4f,
+    position_scale: vec4f,
+};
+
+@group(0) @binding(0) var<uniform> us: uniforms;
+
+// vertex_input holds only the position stream and is prepended to this file, see wga::create_depth_pipeline
+@vertex
+fn vs_main(in: vertex_input) -> @builtin(position) vec4f
+{
+    return us.projection_matrix * us.view_matrix * us.model_matrix * vec4f(in.position, 1.0);
+}
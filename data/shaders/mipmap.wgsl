@@ -0,0 +1,28 @@
+// One dispatch per mip level, each invocation averages a 2x2 block of the previous level, see wga::mipmap_generator
+@group(0) @binding(0) var source: texture_2d<f32>;
+@group(0) @binding(1) var destination: texture_storage_2d<rgba8unorm, write>;
+
+// Texels are gamma encoded (fs_main linearizes them), so they are averaged in linear space
+fn load_linear(coords: vec2u, source_size: vec2u) -> vec4f
+{
+    let texel = textureLoad(source, vec2i(min(coords, source_size - 1u)), 0);
+    return vec4f(pow(texel.rgb, vec3f(2.2)), texel.a);
+}
+
+@compute @workgroup_size(8, 8)
+fn downsample(@builtin(global_invocation_id) id: vec3u)
+{
+    let size = textureDimensions(destination);
+    if (id.x >= size.x || id.y >= size.y) {
+        return;
+    }
+
+    // Odd sizes clamp the second texel to the edge instead of reading outside the source
+    let source_size = textureDimensions(source);
+    let coords = id.xy * 2u;
+    let color = (load_linear(coords, source_size) +
+                 load_linear(coords + vec2u(1u, 0u), source_size) +
+                 load_linear(coords + vec2u(0u, 1u), source_size) +
+                 load_linear(coords + vec2u(1u, 1u), source_size)) * 0.25;
+    textureStore(destination, vec2i(id.xy), vec4f(pow(color.rgb, vec3f(1.0 / 2.2)), color.a));
+}
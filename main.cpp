@@ -1,6 +1,9 @@
+#include <array>
 #include <iostream>
 #include <optional>
 #include <chrono>
+#include <cmath>
+#include <tuple>
 
 #include <cstdlib>
 
@@ -20,20 +23,39 @@
 #include <glm/ext.hpp>
 
 #include <wga/wga.hpp>
+#include <wga/benchmark.hpp>
 #include <wga/setup.hpp>
 #include <wga/model.hpp>
+#include <wga/asset_loader.hpp>
+#include <wga/culling.hpp>
+#include <wga/scene.hpp>
+#include <wga/image_processing.hpp>
+#include <wga/material_textures.hpp>
 
-int main() {
+int main(int argc, char **argv) {
     std::cout << "Hello, World!" << std::endl;
 
     try {
-        wga::glfw_init glfw_init;
+        const auto benchmark_options = wga::parse_benchmark_options(argc, argv);
+        const bool headless = benchmark_options.headless;
+
+        // Headless runs need neither GLFW nor a window
+        std::optional<wga::glfw_init> glfw_init;
+        if (!headless) {
+            glfw_init.emplace();
+        }
 
         static constexpr std::uint32_t width{640};
         static constexpr std::uint32_t height{480};
-        auto window = wga::create_window(width, height);
+        auto window = headless ? wga::window_t{} : wga::create_window(width, height);
 
-        auto context = wga::setup(window, width, height, 1);
+        // A grid of copies of the model, each drawn with its own uniform block, plus one block with the camera for the
+        // instanced draw
+        static constexpr std::uint32_t grid_size{4};
+        static constexpr std::uint32_t object_count{grid_size * grid_size};
+        static constexpr std::uint32_t uniform_count{object_count + 1};
+        auto context = headless ? wga::setup_headless(width, height, uniform_count)
+                                : wga::setup(window, width, height, uniform_count, benchmark_options.present_mode);
 
         auto MM = [] {
             float angle = 0.0f;
@@ -70,129 +92,174 @@ int main() {
                 {0.0f, 1.0f, 0.4f, 1.0f}, 1.0f};
         static_assert(sizeof(uniforms) % 16 == 0);
 
-        context.queue.get().writeBuffer(context.uniform_buffer.get(), 0, &uniforms, sizeof(wga::shader_type::uniforms));
-
         wgpu::SupportedLimits supported_limits;
         context.device.get().getLimits(&supported_limits);
         std::clog << "device.maxVertexAttributes: " << supported_limits.limits.maxVertexAttributes << '\n';
 
         //auto model = wga::create_model(context, "../data/models/webgpu.txt", 2);
         //auto model = wga::create_model(context, "../data/models/pyramid.txt", 6);
-        auto model = wga::create_model_obj(context, "../data/models/cube.obj");
-
-        auto uniform_stride = get_uniform_buffer_stride(context.device);
-
-
-        wgpu::TextureDescriptor texture_desc;
-        texture_desc.dimension = wgpu::TextureDimension::_2D;
-        texture_desc.format = wgpu::TextureFormat::RGBA8Unorm;
-        texture_desc.mipLevelCount = 1;
-        texture_desc.sampleCount = 1;
-        texture_desc.size = {256, 256, 1};
-        texture_desc.usage = wgpu::TextureUsage::CopyDst | wgpu::TextureUsage::TextureBinding;
-        texture_desc.viewFormatCount = 0;
-        texture_desc.viewFormats = nullptr;
-        auto texture = wga::object<wgpu::Texture, true>{
-                context.device.get().createTexture(texture_desc)};
-
-        wgpu::TextureViewDescriptor texture_view_desc;
-        texture_view_desc.aspect = wgpu::TextureAspect::All;
-        texture_view_desc.baseArrayLayer = 0;
-        texture_view_desc.arrayLayerCount = 1;
-        texture_view_desc.baseMipLevel = 0;
-        texture_view_desc.mipLevelCount = 1;
-        texture_view_desc.dimension = wgpu::TextureViewDimension::_2D;
-        texture_view_desc.format = texture_desc.format;
-        auto texture_view = wga::object{texture.get().createView(texture_view_desc)};
-
-        auto bind_group = wga::create_bind_group(context.device, context.uniform_buffer, context.bind_group_layout,
-                                                 texture_view);
-
-        std::vector<uint32_t> pixels(4 * texture_desc.size.width * texture_desc.size.height);
-        for (std::uint32_t i = 0; i < texture_desc.size.width; ++i) {
-            for (std::uint32_t j = 0; j < texture_desc.size.height; ++j) {
-                std::uint32_t *p = &pixels[j * texture_desc.size.width + i];
-                if constexpr (false) {
-                    auto p1 = static_cast<std::uint32_t>(static_cast<std::uint8_t>(i) << 24);
-                    auto p2 = static_cast<std::uint32_t>(static_cast<std::uint8_t>(j) << 16);
-                    auto p3 = static_cast<std::uint32_t>(128u << 8);
-                    auto p4 = static_cast<std::uint32_t>(255u << 0);
-                    *p = p1 | p2 | p3 | p4;
-                } else {
-                    auto p1 = static_cast<std::uint32_t>(
-                            static_cast<std::uint8_t>((i / 16) % 2 == (j / 16) % 2 ? 255u : 0) << 0);
-                    auto p2 = static_cast<std::uint32_t>(
-                            static_cast<std::uint8_t>(((i - j) / 16) % 2 == 0 ? 255u : 0) << 8);
-                    auto p3 = static_cast<std::uint32_t>(
-                            static_cast<std::uint8_t>(((i + j) / 16) % 2 == 0 ? 255u : 0) << 16);
-                    auto p4 = static_cast<std::uint32_t>(255u << 24);
-                    *p = p1 | p2 | p3 | p4;
+        // The cube loads in the background, a quad is drawn until it is uploaded
+        wga::asset_loader asset_loader;
+        auto placeholder = wga::create_placeholder_model(context);
+        auto model_asset = asset_loader.load_model_obj("../data/models/cube.obj");
+
+        // A ring of small copies around the grid, all drawn with one instanced draw call
+        static constexpr std::uint32_t instance_count{256};
+        // Compiled in the background, the ring is skipped until it is ready. It is lit and untextured, a permutation
+        // of the same shader with the texture path compiled out
+        wga::shader_features ring_features;
+        ring_features.lighting = true;
+        ring_features.texture = false;
+        auto &instanced_pipeline = wga::request_instanced_pipeline(context, wga::full_vertex_format, ring_features);
+        auto instances = wga::create_instance_buffer(context.device, instance_count);
+        std::vector<wga::shader_type::instance_attributes> instance_data(instance_count);
+
+        // Objects and instances outside the camera frustum are not encoded
+        const auto frustum = wga::get_frustum(PM * VM);
+        // The grid is culled and picked through the scene's BVH. Its objects are added once the drawn model is known,
+        // and again when the cube replaces the placeholder
+        wga::scene scene;
+        const wga::model_obj *scene_model = nullptr;
+        wga::cull_bounds instance_bounds;
+        instance_bounds.resize(instance_count);
+        std::vector<std::uint32_t> visible;
+        std::vector<wga::shader_type::instance_attributes> visible_instance_data;
+        std::vector<std::uint32_t> dynamic_offsets;
+
+
+        // Three overlapping stripe patterns, generated row by row on the loader's threads
+        const auto image = wga::generate_image(&asset_loader.pool, 256, 256, [](std::uint32_t x, std::uint32_t y) {
+            const auto red = (x / 16) % 2 == (y / 16) % 2 ? 0xffu : 0u;
+            const auto green = ((x - y) / 16) % 2 == 0 ? 0xffu : 0u;
+            const auto blue = ((x + y) / 16) % 2 == 0 ? 0xffu : 0u;
+            return red | green << 8 | blue << 16 | 0xffu << 24;
+        });
+
+        // Materials are layers of one texture array, so all objects share a bind group. Mip levels are baked and BC7
+        // compressed on the loader's threads, uncompressed without device support
+        auto materials = wga::create_material_textures(context, 256, 256, 2, wga::block_format::bc7);
+        wga::add_material_texture(context, materials, "stripes",
+                                  wga::generate_mip_chain(&asset_loader.pool, image, wga::mip_filter::box),
+                                  &asset_loader.pool);
+        wga::add_material_texture(context, materials, "checkerboard",
+                                  wga::generate_mip_chain(&asset_loader.pool,
+                                                          wga::make_checkerboard(&asset_loader.pool, 256, 256, 32),
+                                                          wga::mip_filter::box),
+                                  &asset_loader.pool);
+        const auto material_count = static_cast<std::uint32_t>(materials.layers.size());
+        auto sampler = wga::create_sampler(context.device, materials.texture.mip_level_count);
+        auto bind_group = wga::create_bind_group(context, materials, sampler);
+
+        wga::benchmark benchmark{benchmark_options};
+        auto start_time = std::chrono::steady_clock::now();
+        while ((headless || !glfwWindowShouldClose(window.get())) &&
+               (benchmark_options.enabled ? !benchmark.done()
+                                          : std::chrono::steady_clock::now() < start_time + std::chrono::seconds(5))) {
+            benchmark.begin_frame();
+
+            if (!headless) {
+                glfwPollEvents();
+
+                int framebuffer_width = 0;
+                int framebuffer_height = 0;
+                glfwGetFramebufferSize(window.get(), &framebuffer_width, &framebuffer_height);
+                if (framebuffer_width == 0 || framebuffer_height == 0) {
+                    benchmark.skip_frame();
+                    continue; // minimized
+                }
+                if (static_cast<std::uint32_t>(framebuffer_width) != context.width ||
+                    static_cast<std::uint32_t>(framebuffer_height) != context.height) {
+                    wga::resize(context, static_cast<std::uint32_t>(framebuffer_width),
+                                static_cast<std::uint32_t>(framebuffer_height));
                 }
             }
-        }
 
-        wgpu::ImageCopyTexture destination;
-        destination.texture = texture.get();
-        destination.mipLevel = 0; // Write to mip level 0
-        destination.origin = {0, 0, 0};
-        destination.aspect = wgpu::TextureAspect::All;
+            benchmark.begin_encode();
+            context.uniform_ring.begin_frame(context.device);
+            context.render_targets.begin_frame();
 
-        wgpu::TextureDataLayout source;
-        source.offset = 0;
-        source.bytesPerRow = 4 * texture_desc.size.width;
-        source.rowsPerImage = texture_desc.size.height;
+            asset_loader.finalize(context);
+            context.pipelines.update();
+            auto &model = wga::get_model(model_asset, placeholder);
+            std::tie(uniforms.position_offset, uniforms.position_scale) = wga::get_position_quantization(model);
+
+            uniforms.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
+            const bool model_changed = &model != scene_model;
+            if (model_changed) {
+                scene = wga::scene{};
+                scene_model = &model;
+            }
+            std::array<glm::mat4x4, object_count> model_matrices;
+            for (std::uint32_t i = 0; i < object_count; ++i) {
+                model_matrices[i] = [&uniforms, i] {
+                    float angle = uniforms.time;
+                    auto S = glm::scale(glm::mat4x4(1.0), glm::vec3(0.3f / grid_size));
+                    auto T = glm::translate(glm::mat4x4(1.0), glm::vec3(
+                            (static_cast<float>(i % grid_size) + 0.5f) / grid_size - 0.5f,
+                            (static_cast<float>(i / grid_size) + 0.5f) / grid_size - 0.5f, 0.0));
+                    auto R = glm::rotate(glm::mat4x4(1.0), angle, glm::vec3(0.0, 0.0, 1.0));
+                    return T * R * S;
+                }();
+                if (model_changed) {
+                    wga::add_object(scene, model_matrices[i], model.bounds);
+                } else {
+                    wga::set_transform(scene, i, model_matrices[i]);
+                }
+            }
+            wga::update_scene(&asset_loader.pool, scene);
+
+            // The object under the cursor is drawn with the next material
+            std::optional<std::uint32_t> picked;
+            if (!headless) {
+                double cursor_x = 0.0;
+                double cursor_y = 0.0;
+                int window_width = 0;
+                int window_height = 0;
+                glfwGetCursorPos(window.get(), &cursor_x, &cursor_y);
+                glfwGetWindowSize(window.get(), &window_width, &window_height);
+                if (window_width > 0 && window_height > 0) {
+                    const glm::vec2 point{static_cast<float>(2.0 * cursor_x / window_width - 1.0),
+                                          static_cast<float>(1.0 - 2.0 * cursor_y / window_height)};
+                    if (const auto hit = wga::pick(scene, wga::get_ray(PM * VM, point))) {
+                        picked = hit->index;
+                    }
+                }
+            }
 
-        context.queue.get().writeTexture(destination, pixels.data(), pixels.size(), source, texture_desc.size);
+            // The instanced pipeline only reads the camera from the uniform block
+            uniforms.model_matrix = MM;
+            const auto camera_offset = context.uniform_ring.push(uniforms);
+            wga::cull(frustum, scene, visible);
+            dynamic_offsets.clear();
+            for (auto i: visible) {
+                uniforms.model_matrix = model_matrices[i];
+                uniforms.texture_layer = (i + (picked == i ? 1u : 0u)) % material_count;
+                dynamic_offsets.push_back(context.uniform_ring.push(uniforms));
+            }
+            context.uniform_ring.upload(context.device, context.staging_belt, context.uniform_buffer);
+
+            for (std::uint32_t i = 0; i < instance_count; ++i) {
+                const float angle = 2.0f * glm::pi<float>() * static_cast<float>(i) / instance_count + uniforms.time;
+                auto T = glm::translate(glm::mat4x4(1.0), glm::vec3(0.7f * std::cos(angle), 0.7f * std::sin(angle), 0.0f));
+                auto S = glm::scale(glm::mat4x4(1.0), glm::vec3(0.02f));
+                instance_data[i].model_matrix = T * S;
+                instance_data[i].color = glm::vec4(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle), 1.0f, 1.0f);
+                instance_bounds.set(i, instance_data[i].model_matrix, model.bounds, model.bounds_radius);
+            }
+            wga::cull(nullptr, frustum, instance_bounds, visible);
+            visible_instance_data.clear();
+            for (auto i: visible) {
+                visible_instance_data.push_back(instance_data[i]);
+            }
+            wga::update_instances(context.device, context.staging_belt, instances, visible_instance_data);
 
-        auto start_time = std::chrono::steady_clock::now();
-        while (!glfwWindowShouldClose(window.get()) && std::chrono::steady_clock::now() < start_time + std::chrono::seconds(5)) {
-            glfwPollEvents();
-
-            uniforms.time = static_cast<float>(glfwGetTime());
-            context.queue.get().writeBuffer(context.uniform_buffer.get(), offsetof(wga::shader_type::uniforms, time),
-                                            &uniforms.time,
-                                            sizeof(wga::shader_type::uniforms::time));
-
-            uniforms.model_matrix = [&uniforms] {
-                float angle = uniforms.time;
-                auto S = glm::scale(glm::mat4x4(1.0), glm::vec3(0.3f));
-                auto T = glm::translate(glm::mat4x4(1.0), glm::vec3(0.0, 0.0, 0.0));
-                auto R = glm::rotate(glm::mat4x4(1.0), angle, glm::vec3(0.0, 0.0, 1.0));
-                return R * T * S;
-            }();
-            context.queue.get().writeBuffer(context.uniform_buffer.get(),
-                                            offsetof(wga::shader_type::uniforms, model_matrix),
-                                            &uniforms.model_matrix,
-                                            sizeof(wga::shader_type::uniforms::model_matrix));
-
-
-            auto next_texture = wga::object{context.swapchain.get().getCurrentTextureView()};
+            auto next_texture = wga::acquire_color_view(context);
             if (!next_texture.get().operator bool()) {
-                std::cerr << "Cannot acquire next swapchain texture\n";
+                std::cerr << "Cannot acquire next color texture\n";
                 break;
             }
 
-            wgpu::TextureDescriptor depth_texture_desc;
-            depth_texture_desc.dimension = wgpu::TextureDimension::_2D;
-            depth_texture_desc.format = context.depth_texture_format;
-            depth_texture_desc.mipLevelCount = 1;
-            depth_texture_desc.sampleCount = 1;
-            depth_texture_desc.size = {width, height, 1};
-            depth_texture_desc.usage = wgpu::TextureUsage::RenderAttachment;
-            depth_texture_desc.viewFormatCount = 1;
-            depth_texture_desc.viewFormats = reinterpret_cast<WGPUTextureFormat *>(&context.depth_texture_format);
-            auto depth_texture = wga::object<wgpu::Texture, true>{
-                    context.device.get().createTexture(depth_texture_desc)};
-
-            wgpu::TextureViewDescriptor depth_texture_view_desc;
-            depth_texture_view_desc.aspect = wgpu::TextureAspect::DepthOnly;
-            depth_texture_view_desc.baseArrayLayer = 0;
-            depth_texture_view_desc.arrayLayerCount = 1;
-            depth_texture_view_desc.baseMipLevel = 0;
-            depth_texture_view_desc.mipLevelCount = 1;
-            depth_texture_view_desc.dimension = wgpu::TextureViewDimension::_2D;
-            depth_texture_view_desc.format = context.depth_texture_format;
-            auto depth_texture_view = wga::object{depth_texture.get().createView(depth_texture_view_desc)};
+            auto &depth_target = wga::acquire_depth_target(context);
 
             wgpu::CommandEncoderDescriptor encoder_descriptor = {};
             encoder_descriptor.nextInChain = nullptr;
@@ -200,6 +267,9 @@ int main() {
             auto encoder = wga::object{
                     context.device.get().createCommandEncoder(encoder_descriptor)};
 
+            // The frame's uploads are copied before the render pass reads them
+            context.staging_belt.encode(encoder.get());
+
             wgpu::RenderPassColorAttachment render_pass_color_attachment = {};
             render_pass_color_attachment.view = next_texture.get();
             render_pass_color_attachment.resolveTarget = nullptr;
@@ -208,7 +278,7 @@ int main() {
             render_pass_color_attachment.clearValue = wgpu::Color{0.9, 0.1, 0.2, 1.0};
 
             wgpu::RenderPassDepthStencilAttachment render_pass_depth_stencil_attachment;
-            render_pass_depth_stencil_attachment.view = depth_texture_view.get();
+            render_pass_depth_stencil_attachment.view = depth_target.view.get();
             render_pass_depth_stencil_attachment.depthClearValue = 1.0f;
             render_pass_depth_stencil_attachment.depthLoadOp = wgpu::LoadOp::Clear;
             render_pass_depth_stencil_attachment.depthStoreOp = wgpu::StoreOp::Store;
@@ -227,17 +297,20 @@ int main() {
             render_pass_desc.timestampWrites = nullptr;
             auto render_pass = wga::object{encoder.get().beginRenderPass(render_pass_desc)};
 
-            render_pass.get().setPipeline(context.pipeline.get());
-
-            render_pass.get().setVertexBuffer(0, model.vertex_buffer.get(), 0, model.vertex_data_size);
+            render_pass.get().setPipeline(context.pipeline);
 
-            uint32_t dynamic_offset = 0 * uniform_stride;
-            render_pass.get().setBindGroup(0, bind_group.get(), 1, &dynamic_offset);
-            render_pass.get().draw(model.index_count, 1, 0, 0);
+            wga::mesh_bindings mesh_bindings;
+            for (auto dynamic_offset: dynamic_offsets) {
+                render_pass.get().setBindGroup(0, bind_group.get(), 1, &dynamic_offset);
+                wga::draw(render_pass.get(), model, mesh_bindings);
+            }
 
-            //dynamic_offset = 1 * uniform_stride;
-            //render_pass.get().setBindGroup(0, context.bind_group.get(), 1, &dynamic_offset);
-            //render_pass.get().drawIndexed(model.index_count, 1, 0, 0, 0);
+            if (auto pipeline = wga::get_pipeline(instanced_pipeline);
+                    pipeline.operator bool() && instances.count > 0) {
+                render_pass.get().setPipeline(pipeline);
+                render_pass.get().setBindGroup(0, bind_group.get(), 1, &camera_offset);
+                wga::draw(render_pass.get(), model, instances);
+            }
 
             render_pass.get().end();
 
@@ -247,8 +320,18 @@ int main() {
             auto command = wga::object{encoder.get().finish(command_buffer_desc)};
 
             context.queue.get().submit(1, &command.get());
+            context.staging_belt.recall();
+            context.uniform_ring.end_frame(context.queue);
+            benchmark.end_encode();
+
+            wga::present(context);
+        }
+
+        context.pipelines.print_stats(std::clog);
 
-            context.swapchain.get().present();
+        if (benchmark_options.enabled) {
+            benchmark.print_summary(std::cout);
+            benchmark.write_json(benchmark_options.output);
         }
 
     } catch (const std::exception &exception) {
@@ -260,5 +343,8 @@ int main() {
         return EXIT_FAILURE;
     }
 
+    // Every wgpu handle has been released by now, anything left is a leak
+    wga::report_live_objects(std::clog);
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,172 @@
+#ifndef WGA_ASSET_LOADER_HPP
+#define WGA_ASSET_LOADER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <wga/model.hpp>
+#include <wga/staging_belt.hpp>
+#include <wga/thread_pool.hpp>
+#include <wga/geometry/synthetic.hpp>
+
+// Models loaded in the background: parsing, encoding and the mesh cache run on a thread pool, only reserving arena
+// ranges and staging the payload happen on the render thread, spread over frames by a time budget
+namespace wga {
+    enum class asset_state {
+        loading,   // on the thread pool
+        uploading, // being staged by finalize
+        ready,
+        failed
+    };
+
+    struct model_asset {
+        std::filesystem::path path;
+        wga::asset_state state{wga::asset_state::loading};
+        std::optional<wga::model_obj> model; // set once uploading starts, only drawable when ready
+
+        [[nodiscard]] auto ready() const noexcept -> bool {
+            return state == wga::asset_state::ready;
+        }
+    };
+
+    // Returned right away by asset_loader::load_model_obj, owned by the caller
+    using model_asset_handle = std::shared_ptr<wga::model_asset>;
+
+    struct pending_model {
+        wga::model_asset_handle asset;
+        wga::vertex_format vertex_format;
+        std::future<wga::model_obj_data> future;
+        std::optional<wga::model_obj_data> data;
+        std::uint64_t vertex_offset{0};
+        std::uint64_t index_offset{0};
+    };
+
+    struct asset_loader {
+        // Render thread time finalize may spend per frame, at least one slice is staged per call
+        std::chrono::microseconds frame_budget{2000};
+        // Payloads are staged in slices of this size, so a large mesh takes several frames instead of one long one
+        std::uint64_t upload_slice{wga::default_staging_chunk_size};
+
+        std::vector<wga::pending_model> pending;
+        wga::thread_pool pool;
+
+        // The asset keeps rendering as a placeholder until it is ready, see get_model
+        auto load_model_obj(const std::filesystem::path &path,
+                            const wga::vertex_format &vertex_format = wga::full_vertex_format)
+        -> wga::model_asset_handle {
+            auto asset = std::make_shared<wga::model_asset>();
+            asset->path = path;
+            pending.push_back({asset, vertex_format, pool.submit([path, vertex_format] {
+                return wga::load_model_obj_data(path, vertex_format);
+            }), std::nullopt, 0, 0});
+            return asset;
+        }
+
+        // Call on the render thread before the frame's staging belt is encoded, models finished here are drawable in
+        // the same frame
+        void finalize(wga::context &context) {
+            const auto deadline = std::chrono::steady_clock::now() + frame_budget;
+            bool staged = false;
+            for (auto &model: pending) {
+                // Dropped by the caller, the worker's result and any reserved ranges are discarded
+                if (model.asset.use_count() == 1) {
+                    model.asset->state = wga::asset_state::failed;
+                    continue;
+                }
+                if (!model.data) {
+                    if (model.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                        continue;
+                    }
+                    try {
+                        model.data.emplace(model.future.get());
+                        model.asset->model.emplace(
+                                wga::reserve_model_obj(context, model.data->header, model.vertex_format));
+                    } catch (const std::exception &exception) {
+                        std::cerr << "Could not load " << model.asset->path.string() << ": " << exception.what()
+                                  << '\n';
+                        model.asset->state = wga::asset_state::failed;
+                        continue;
+                    }
+                    model.asset->state = wga::asset_state::uploading;
+                }
+
+                while (model.asset->state == wga::asset_state::uploading) {
+                    if (staged && std::chrono::steady_clock::now() >= deadline) {
+                        erase_finished();
+                        return;
+                    }
+                    stage_slice(context, model);
+                    staged = true;
+                }
+            }
+            erase_finished();
+        }
+
+        void stage_slice(wga::context &context, wga::pending_model &model) {
+            const auto &header = model.data->header;
+            const auto id = model.asset->model->mesh.id;
+            if (model.vertex_offset < header.vertex_size) {
+                const auto size = std::min(upload_slice, header.vertex_size - model.vertex_offset);
+                context.meshes.write_vertices(context.device, context.staging_belt, id, model.vertex_offset,
+                                              static_cast<const std::byte *>(model.data->vertex_payload()) +
+                                              model.vertex_offset, size);
+                model.vertex_offset += size;
+            } else if (model.index_offset < header.index_size) {
+                const auto size = std::min(upload_slice, header.index_size - model.index_offset);
+                context.meshes.write_indices(context.device, context.staging_belt, id, model.index_offset,
+                                             static_cast<const std::byte *>(model.data->index_payload()) +
+                                             model.index_offset, size);
+                model.index_offset += size;
+            }
+            if (model.vertex_offset >= header.vertex_size && model.index_offset >= header.index_size) {
+                model.asset->state = wga::asset_state::ready;
+            }
+        }
+
+        void erase_finished() {
+            pending.erase(std::remove_if(pending.begin(), pending.end(), [](const auto &model) {
+                return model.asset->state == wga::asset_state::ready || model.asset->state == wga::asset_state::failed;
+            }), pending.end());
+        }
+
+        [[nodiscard]] auto idle() const noexcept -> bool {
+            return pending.empty();
+        }
+    };
+
+    // The asset's model once it is ready, placeholder until then or if it failed to load
+    auto get_model(const wga::model_asset_handle &asset, wga::model_obj &placeholder) -> wga::model_obj & {
+        return asset && asset->ready() ? *asset->model : placeholder;
+    }
+
+    // A unit quad in the full vertex format, drawn in place of models that are still loading
+    auto create_placeholder_model(wga::context &context) -> wga::model_obj {
+        const auto mesh = wga::geometry::make_grid_mesh(2);
+        const auto vertex_data = wga::geometry::make_vertex_attributes(mesh);
+        const auto bounds = wga::geometry::compute_bounds(vertex_data);
+        const auto encoded = wga::encode_vertices(wga::full_vertex_format, vertex_data, bounds.min, bounds.max);
+
+        wga::geometry::mesh_header header{};
+        header.index_format = wga::geometry::mesh_index_format::uint32;
+        header.vertex_count = vertex_data.size();
+        header.index_count = mesh.indices.size();
+        header.vertex_size = encoded.size();
+        header.index_size = wga::bytesize(mesh.indices);
+        std::memcpy(header.bounds_min, &bounds.min, sizeof(header.bounds_min));
+        std::memcpy(header.bounds_max, &bounds.max, sizeof(header.bounds_max));
+        header.bounds_radius = wga::geometry::compute_bounding_radius(vertex_data, bounds);
+        return wga::create_model_obj(context, header, encoded.data(), mesh.indices.data(), wga::full_vertex_format);
+    }
+}
+
+#endif //WGA_ASSET_LOADER_HPP
@@ -0,0 +1,224 @@
+#ifndef WGA_BENCHMARK_HPP
+#define WGA_BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+// Benchmark run mode: unlocked present mode, a frame or duration budget after a warm-up, and frame time statistics
+namespace wga {
+    struct benchmark_options {
+        bool enabled{false};
+        bool headless{false};           // no window, renders into an offscreen color target
+        wgpu::PresentMode present_mode{wgpu::PresentMode::Fifo};
+        std::uint32_t frame_count{0};   // 0 runs until duration is reached
+        double duration{5.0};           // seconds, after the warm-up
+        double warmup{1.0};             // seconds
+        std::filesystem::path output{"benchmark.json"};
+    };
+
+    auto get_present_mode_name(wgpu::PresentMode present_mode) -> std::string_view {
+        switch (present_mode) {
+            case wgpu::PresentMode::Immediate:
+                return "immediate";
+            case wgpu::PresentMode::Mailbox:
+                return "mailbox";
+            default:
+                return "fifo";
+        }
+    }
+
+    auto parse_present_mode(std::string_view name) -> wgpu::PresentMode {
+        if (name == "immediate") {
+            return wgpu::PresentMode::Immediate;
+        }
+        if (name == "mailbox") {
+            return wgpu::PresentMode::Mailbox;
+        }
+        if (name == "fifo") {
+            return wgpu::PresentMode::Fifo;
+        }
+        std::cerr << "Unknown present mode " << name << ", expected immediate, mailbox or fifo\n";
+        throw std::runtime_error("Unknown present mode");
+    }
+
+    // --benchmark [--headless] [--present-mode=immediate|mailbox|fifo] [--frames=N] [--duration=S] [--warmup=S]
+    // [--output=file]
+    // Present mode defaults to immediate in benchmark mode and fifo otherwise
+    auto parse_benchmark_options(int argc, char **argv) -> wga::benchmark_options {
+        wga::benchmark_options options;
+        std::optional<wgpu::PresentMode> present_mode;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view argument = argv[i];
+            const auto separator = argument.find('=');
+            const auto name = argument.substr(0, separator);
+            const auto value = separator == std::string_view::npos ? std::string_view{} : argument.substr(separator + 1);
+
+            try {
+                if (name == "--benchmark") {
+                    options.enabled = true;
+                } else if (name == "--headless") {
+                    options.headless = true;
+                } else if (name == "--present-mode") {
+                    present_mode = wga::parse_present_mode(value);
+                } else if (name == "--frames") {
+                    options.frame_count = static_cast<std::uint32_t>(std::stoul(std::string(value)));
+                } else if (name == "--duration") {
+                    options.duration = std::stod(std::string(value));
+                } else if (name == "--warmup") {
+                    options.warmup = std::stod(std::string(value));
+                } else if (name == "--output") {
+                    options.output = std::string(value);
+                } else {
+                    std::cerr << "Unknown argument " << argument << '\n';
+                    throw std::runtime_error("Unknown argument");
+                }
+            } catch (const std::logic_error &) {
+                std::cerr << "Invalid value in argument " << argument << '\n';
+                throw std::runtime_error("Invalid argument");
+            }
+        }
+
+        options.present_mode = present_mode.value_or(options.enabled ? wgpu::PresentMode::Immediate
+                                                                     : wgpu::PresentMode::Fifo);
+        return options;
+    }
+
+    struct frame_time_summary {
+        double min;
+        double avg;
+        double p50;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    // Nearest rank percentiles, values in milliseconds
+    auto summarize_frame_times(std::vector<double> times) -> wga::frame_time_summary {
+        if (times.empty()) {
+            return {};
+        }
+        std::sort(times.begin(), times.end());
+        auto percentile = [&times](double p) {
+            const auto rank = static_cast<std::size_t>(p / 100.0 * static_cast<double>(times.size() - 1) + 0.5);
+            return times[rank];
+        };
+        const double sum = std::accumulate(times.begin(), times.end(), 0.0);
+        return {times.front(), sum / static_cast<double>(times.size()),
+                percentile(50.0), percentile(95.0), percentile(99.0), times.back()};
+    }
+
+    struct benchmark {
+        using clock = std::chrono::steady_clock;
+
+        wga::benchmark_options options;
+        clock::time_point start_time{clock::now()};
+        clock::time_point measure_time{};
+        clock::time_point frame_start{};
+        clock::time_point encode_start{};
+        double encode_time{0.0};
+        bool measuring{false};
+        bool skipped{false}; // the current frame was not rendered, e.g. while minimized
+
+        std::vector<double> frame_times{}; // ms, from frame start to frame start, including present
+        std::vector<double> encode_times{}; // ms, CPU time spent recording and submitting commands
+
+        static auto milliseconds(clock::duration duration) -> double {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        }
+
+        void begin_frame() {
+            const auto now = clock::now();
+            if (measuring && !skipped) {
+                frame_times.push_back(milliseconds(now - frame_start));
+                encode_times.push_back(encode_time);
+            } else if (!measuring && std::chrono::duration<double>(now - start_time).count() >= options.warmup) {
+                measuring = true;
+                measure_time = now;
+            }
+            skipped = false;
+            frame_start = now;
+        }
+
+        // Leaves the current frame out of the statistics, it neither encoded nor presented anything
+        void skip_frame() {
+            skipped = true;
+            encode_time = 0.0;
+        }
+
+        void begin_encode() {
+            encode_start = clock::now();
+        }
+
+        void end_encode() {
+            encode_time = milliseconds(clock::now() - encode_start);
+        }
+
+        [[nodiscard]] auto done() const -> bool {
+            if (!measuring) {
+                return false;
+            }
+            if (options.frame_count > 0) {
+                return frame_times.size() >= options.frame_count;
+            }
+            return std::chrono::duration<double>(clock::now() - measure_time).count() >= options.duration;
+        }
+
+        void print_summary(std::ostream &stream) const {
+            auto print = [&stream](std::string_view name, const wga::frame_time_summary &summary) {
+                stream << std::fixed << std::setprecision(3) << name
+                       << " ms: min " << summary.min << ", avg " << summary.avg << ", p50 " << summary.p50
+                       << ", p95 " << summary.p95 << ", p99 " << summary.p99 << ", max " << summary.max << '\n';
+            };
+
+            const auto total = wga::summarize_frame_times(frame_times);
+            stream << "Benchmark: " << frame_times.size() << " frames, present mode "
+                   << wga::get_present_mode_name(options.present_mode) << ", "
+                   << (total.avg > 0.0 ? 1000.0 / total.avg : 0.0) << " fps\n";
+            print("Frame ", total);
+            print("Encode", wga::summarize_frame_times(encode_times));
+        }
+
+        bool write_json(const std::filesystem::path &path) const {
+            std::ofstream stream(path);
+            if (!stream) {
+                std::cerr << "Could not write benchmark results to " << path.string() << '\n';
+                return false;
+            }
+
+            auto write = [&stream](std::string_view name, const wga::frame_time_summary &summary) {
+                stream << "  \"" << name << "\": {\"min\": " << summary.min << ", \"avg\": " << summary.avg
+                       << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95
+                       << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "}";
+            };
+
+            stream << std::setprecision(6) << "{\n"
+                   << "  \"headless\": " << (options.headless ? "true" : "false") << ",\n"
+                   << "  \"present_mode\": \"" << wga::get_present_mode_name(options.present_mode) << "\",\n"
+                   << "  \"warmup_seconds\": " << options.warmup << ",\n"
+                   << "  \"frames\": " << frame_times.size() << ",\n";
+            write("frame_ms", wga::summarize_frame_times(frame_times));
+            stream << ",\n";
+            write("encode_ms", wga::summarize_frame_times(encode_times));
+            stream << "\n}\n";
+
+            std::clog << "Wrote benchmark results to " << path.string() << '\n';
+            return static_cast<bool>(stream);
+        }
+    };
+}
+
+#endif //WGA_BENCHMARK_HPP
@@ -0,0 +1,462 @@
+#ifndef WGA_BLOCK_COMPRESSION_HPP
+#define WGA_BLOCK_COMPRESSION_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <wga/image.hpp>
+#include <wga/image_processing.hpp>
+
+// CPU encoder for BC1, BC3, BC5 and BC7 textures, for baking at build time rather than per frame: endpoints come from
+// the principal axis of each 4x4 block, indices from the nearest palette entry
+namespace wga {
+    enum class block_format : std::uint8_t {
+        bc1, // RGB and 1 bit alpha, 8 bytes per block
+        bc3, // RGBA, 16 bytes per block
+        bc5, // two channels, e.g. normal maps, 16 bytes per block
+        bc7, // RGBA, mode 6 only, 16 bytes per block
+    };
+
+    static constexpr std::uint32_t block_dimension = 4;
+
+    constexpr auto get_block_bytes(wga::block_format format) -> std::uint32_t {
+        return format == wga::block_format::bc1 ? 8 : 16;
+    }
+
+    // Blocks in rows, partial blocks at the right and bottom edge repeat the edge texels
+    struct compressed_image {
+        wga::block_format format;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::vector<std::uint8_t> blocks;
+
+        [[nodiscard]] auto blocks_wide() const noexcept -> std::uint32_t {
+            return (width + wga::block_dimension - 1) / wga::block_dimension;
+        }
+
+        [[nodiscard]] auto blocks_high() const noexcept -> std::uint32_t {
+            return (height + wga::block_dimension - 1) / wga::block_dimension;
+        }
+
+        [[nodiscard]] auto bytes_per_row() const noexcept -> std::uint32_t {
+            return blocks_wide() * wga::get_block_bytes(format);
+        }
+    };
+
+    using block_texels = std::array<std::array<std::uint8_t, 4>, 16>;
+
+    auto load_block(const wga::image &image, std::uint32_t block_x, std::uint32_t block_y) -> wga::block_texels {
+        wga::block_texels texels{};
+        for (std::uint32_t y = 0; y < wga::block_dimension; ++y) {
+            const auto source_y = std::min(block_y * wga::block_dimension + y, image.height - 1);
+            for (std::uint32_t x = 0; x < wga::block_dimension; ++x) {
+                const auto source_x = std::min(block_x * wga::block_dimension + x, image.width - 1);
+                std::memcpy(texels[y * wga::block_dimension + x].data(),
+                            image.pixels.data() + (std::size_t{source_y} * image.width + source_x) * 4, 4);
+            }
+        }
+        return texels;
+    }
+
+    // The two ends of the texels' spread along their principal axis over the first N channels, texels outside mask
+    // are ignored. The axis is found by power iteration on the covariance matrix
+    template<std::size_t N>
+    auto get_principal_endpoints(const wga::block_texels &texels, std::uint32_t mask = 0xffff)
+    -> std::pair<std::array<float, N>, std::array<float, N>> {
+        std::array<float, N> mean{};
+        if ((mask & 0xffffu) == 0) {
+            return {mean, mean};
+        }
+        std::array<float, N> low{};
+        std::array<float, N> high{};
+        low.fill(255.0f);
+        float count = 0.0f;
+        for (std::size_t i = 0; i < texels.size(); ++i) {
+            if (mask & (1u << i)) {
+                for (std::size_t c = 0; c < N; ++c) {
+                    const auto value = static_cast<float>(texels[i][c]);
+                    mean[c] += value;
+                    low[c] = std::min(low[c], value);
+                    high[c] = std::max(high[c], value);
+                }
+                count += 1.0f;
+            }
+        }
+        for (auto &value: mean) {
+            value /= count;
+        }
+
+        std::array<std::array<float, N>, N> covariance{};
+        for (std::size_t i = 0; i < texels.size(); ++i) {
+            if (mask & (1u << i)) {
+                for (std::size_t a = 0; a < N; ++a) {
+                    for (std::size_t b = 0; b < N; ++b) {
+                        covariance[a][b] += (static_cast<float>(texels[i][a]) - mean[a]) *
+                                            (static_cast<float>(texels[i][b]) - mean[b]);
+                    }
+                }
+            }
+        }
+
+        std::array<float, N> axis{};
+        for (std::size_t c = 0; c < N; ++c) {
+            axis[c] = high[c] - low[c];
+        }
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            std::array<float, N> next{};
+            float length = 0.0f;
+            for (std::size_t a = 0; a < N; ++a) {
+                for (std::size_t b = 0; b < N; ++b) {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length = std::max(length, std::abs(next[a]));
+            }
+            if (length <= 0.0f) {
+                break;
+            }
+            for (std::size_t c = 0; c < N; ++c) {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float axis_length = 0.0f;
+        for (auto value: axis) {
+            axis_length += value * value;
+        }
+        if (axis_length <= 0.0f) {
+            return {mean, mean};
+        }
+
+        auto min_projection = std::numeric_limits<float>::max();
+        auto max_projection = std::numeric_limits<float>::lowest();
+        for (std::size_t i = 0; i < texels.size(); ++i) {
+            if (mask & (1u << i)) {
+                float projection = 0.0f;
+                for (std::size_t c = 0; c < N; ++c) {
+                    projection += (static_cast<float>(texels[i][c]) - mean[c]) * axis[c];
+                }
+                min_projection = std::min(min_projection, projection);
+                max_projection = std::max(max_projection, projection);
+            }
+        }
+
+        std::array<float, N> start{};
+        std::array<float, N> end{};
+        for (std::size_t c = 0; c < N; ++c) {
+            start[c] = std::clamp(mean[c] + axis[c] * min_projection / axis_length, 0.0f, 255.0f);
+            end[c] = std::clamp(mean[c] + axis[c] * max_projection / axis_length, 0.0f, 255.0f);
+        }
+        return {start, end};
+    }
+
+    template<std::size_t N>
+    auto get_nearest(const std::array<std::uint8_t, 4> &texel, const std::array<std::array<int, 4>, 16> &palette,
+                     std::size_t palette_size) -> std::uint32_t {
+        std::uint32_t nearest = 0;
+        auto nearest_distance = std::numeric_limits<int>::max();
+        for (std::size_t i = 0; i < palette_size; ++i) {
+            int distance = 0;
+            for (std::size_t c = 0; c < N; ++c) {
+                const auto difference = static_cast<int>(texel[c]) - palette[i][c];
+                distance += difference * difference;
+            }
+            if (distance < nearest_distance) {
+                nearest_distance = distance;
+                nearest = static_cast<std::uint32_t>(i);
+            }
+        }
+        return nearest;
+    }
+
+    constexpr auto pack_rgb565(const std::array<float, 3> &color) -> std::uint16_t {
+        const auto r = static_cast<std::uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+        const auto g = static_cast<std::uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+        const auto b = static_cast<std::uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<std::uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    constexpr auto unpack_rgb565(std::uint16_t color) -> std::array<int, 4> {
+        const int r = color >> 11 & 31;
+        const int g = color >> 5 & 63;
+        const int b = color & 31;
+        return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255};
+    }
+
+    // BC1 color block, also the color half of BC3. With transparency texels with alpha below 128 use the
+    // transparent black entry of the 3 color mode, otherwise the 4 color mode is used
+    void encode_color_block(const wga::block_texels &texels, bool transparency, std::uint8_t *block) {
+        std::uint32_t opaque = 0;
+        for (std::size_t i = 0; i < texels.size(); ++i) {
+            if (!transparency || texels[i][3] >= 128) {
+                opaque |= 1u << i;
+            }
+        }
+
+        const auto [start, end] = wga::get_principal_endpoints<3>(texels, opaque);
+        auto color_0 = wga::pack_rgb565(end);
+        auto color_1 = wga::pack_rgb565(start);
+        // color_0 > color_1 selects the 4 color mode, color_0 <= color_1 the 3 color mode
+        const bool three_colors = opaque != 0xffff;
+        if (three_colors ? color_0 > color_1 : color_0 < color_1) {
+            std::swap(color_0, color_1);
+        }
+
+        std::array<std::array<int, 4>, 16> palette{};
+        palette[0] = wga::unpack_rgb565(color_0);
+        palette[1] = wga::unpack_rgb565(color_1);
+        for (std::size_t c = 0; c < 3; ++c) {
+            if (three_colors) {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            } else {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+        }
+
+        std::uint32_t indices = 0;
+        if (color_0 != color_1 || three_colors) {
+            for (std::size_t i = 0; i < texels.size(); ++i) {
+                const auto index = (opaque & (1u << i)) ? wga::get_nearest<3>(texels[i], palette, three_colors ? 3 : 4)
+                                                        : 3u;
+                indices |= index << (2 * i);
+            }
+        }
+
+        block[0] = static_cast<std::uint8_t>(color_0);
+        block[1] = static_cast<std::uint8_t>(color_0 >> 8);
+        block[2] = static_cast<std::uint8_t>(color_1);
+        block[3] = static_cast<std::uint8_t>(color_1 >> 8);
+        std::memcpy(block + 4, &indices, 4);
+    }
+
+    // BC4 block of one channel, the alpha half of BC3 and each half of BC5, in the 8 value mode
+    void encode_channel_block(const wga::block_texels &texels, std::size_t channel, std::uint8_t *block) {
+        int high = 0;
+        int low = 255;
+        for (const auto &texel: texels) {
+            high = std::max(high, static_cast<int>(texel[channel]));
+            low = std::min(low, static_cast<int>(texel[channel]));
+        }
+
+        std::uint64_t indices = 0;
+        if (high != low) {
+            for (std::size_t i = 0; i < texels.size(); ++i) {
+                // Steps of 1/7 from low to high, palette entries 2 to 7 lie in between, high first
+                const auto step = (static_cast<int>(texels[i][channel]) - low) * 14 / (high - low) + 1;
+                const auto t = static_cast<std::uint64_t>(std::clamp(step / 2, 0, 7));
+                const auto index = t == 7 ? 0 : t == 0 ? 1 : 8 - t;
+                indices |= index << (3 * i);
+            }
+        }
+
+        block[0] = static_cast<std::uint8_t>(high);
+        block[1] = static_cast<std::uint8_t>(low);
+        for (std::size_t i = 0; i < 6; ++i) {
+            block[2 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    // Little endian bit stream of a 128 bit block
+    struct block_bit_writer {
+        std::uint8_t *block;
+        std::uint32_t position{0};
+
+        void write(std::uint32_t value, std::uint32_t bits) {
+            for (std::uint32_t i = 0; i < bits; ++i, ++position) {
+                if (value >> i & 1u) {
+                    block[position / 8] = static_cast<std::uint8_t>(block[position / 8] | 1u << (position % 8));
+                }
+            }
+        }
+    };
+
+    // 7 bits per channel and a p-bit shared by the endpoint's channels, the p-bit with the smaller error wins
+    auto quantize_bc7_endpoint(const std::array<float, 4> &endpoint)
+    -> std::pair<std::array<std::uint32_t, 4>, std::uint32_t> {
+        std::pair<std::array<std::uint32_t, 4>, std::uint32_t> best{};
+        auto best_error = std::numeric_limits<float>::max();
+        for (std::uint32_t p = 0; p < 2; ++p) {
+            std::array<std::uint32_t, 4> channels{};
+            float error = 0.0f;
+            for (std::size_t c = 0; c < 4; ++c) {
+                const auto value = std::clamp((endpoint[c] - static_cast<float>(p)) / 2.0f + 0.5f, 0.0f, 127.0f);
+                channels[c] = static_cast<std::uint32_t>(value);
+                const auto difference = static_cast<float>(channels[c] << 1 | p) - endpoint[c];
+                error += difference * difference;
+            }
+            if (error < best_error) {
+                best_error = error;
+                best = {channels, p};
+            }
+        }
+        return best;
+    }
+
+    static constexpr std::array<int, 16> bc7_weights{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct bc7_endpoints {
+        std::array<std::uint32_t, 4> channels_0;
+        std::uint32_t p_0;
+        std::array<std::uint32_t, 4> channels_1;
+        std::uint32_t p_1;
+    };
+
+    auto quantize_bc7_endpoints(const std::array<float, 4> &start, const std::array<float, 4> &end)
+    -> wga::bc7_endpoints {
+        const auto [channels_0, p_0] = wga::quantize_bc7_endpoint(start);
+        const auto [channels_1, p_1] = wga::quantize_bc7_endpoint(end);
+        return {channels_0, p_0, channels_1, p_1};
+    }
+
+    // Nearest palette entry per texel, returns the squared error
+    auto fit_bc7_indices(const wga::block_texels &texels, const wga::bc7_endpoints &endpoints,
+                         std::array<std::uint32_t, 16> &indices) -> int {
+        std::array<std::array<int, 4>, 16> palette{};
+        for (std::size_t i = 0; i < wga::bc7_weights.size(); ++i) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                const auto e_0 = static_cast<int>(endpoints.channels_0[c] << 1 | endpoints.p_0);
+                const auto e_1 = static_cast<int>(endpoints.channels_1[c] << 1 | endpoints.p_1);
+                palette[i][c] = ((64 - wga::bc7_weights[i]) * e_0 + wga::bc7_weights[i] * e_1 + 32) >> 6;
+            }
+        }
+
+        int error = 0;
+        for (std::size_t i = 0; i < texels.size(); ++i) {
+            indices[i] = wga::get_nearest<4>(texels[i], palette, palette.size());
+            for (std::size_t c = 0; c < 4; ++c) {
+                const auto difference = static_cast<int>(texels[i][c]) - palette[indices[i]][c];
+                error += difference * difference;
+            }
+        }
+        return error;
+    }
+
+    // Least squares endpoints for fixed indices, false if all texels use the same weight
+    auto refine_bc7_endpoints(const wga::block_texels &texels, const std::array<std::uint32_t, 16> &indices,
+                              std::array<float, 4> &start, std::array<float, 4> &end) -> bool {
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        std::array<float, 4> ax{};
+        std::array<float, 4> bx{};
+        for (std::size_t i = 0; i < texels.size(); ++i) {
+            const auto b = static_cast<float>(wga::bc7_weights[indices[i]]) / 64.0f;
+            const auto a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (std::size_t c = 0; c < 4; ++c) {
+                ax[c] += a * static_cast<float>(texels[i][c]);
+                bx[c] += b * static_cast<float>(texels[i][c]);
+            }
+        }
+        const auto determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) {
+            return false;
+        }
+        for (std::size_t c = 0; c < 4; ++c) {
+            start[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+            end[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    // Mode 6: one subset, RGBA endpoints and 16 interpolation steps. The principal axis endpoints get one least
+    // squares refinement, kept when it lowers the error
+    void encode_bc7_block(const wga::block_texels &texels, std::uint8_t *block) {
+        auto [start, end] = wga::get_principal_endpoints<4>(texels);
+        auto endpoints = wga::quantize_bc7_endpoints(start, end);
+        std::array<std::uint32_t, 16> indices{};
+        const auto error = wga::fit_bc7_indices(texels, endpoints, indices);
+        if (error > 0 && wga::refine_bc7_endpoints(texels, indices, start, end)) {
+            const auto refined = wga::quantize_bc7_endpoints(start, end);
+            std::array<std::uint32_t, 16> refined_indices{};
+            if (wga::fit_bc7_indices(texels, refined, refined_indices) < error) {
+                endpoints = refined;
+                indices = refined_indices;
+            }
+        }
+
+        auto [channels_0, p_0, channels_1, p_1] = endpoints;
+        // The first texel's index is stored without its top bit, which must be 0
+        if (indices[0] >= 8) {
+            std::swap(channels_0, channels_1);
+            std::swap(p_0, p_1);
+            for (auto &index: indices) {
+                index = 15 - index;
+            }
+        }
+
+        std::memset(block, 0, 16);
+        wga::block_bit_writer writer{block};
+        writer.write(1u << 6, 7);
+        for (std::size_t c = 0; c < 4; ++c) {
+            writer.write(channels_0[c], 7);
+            writer.write(channels_1[c], 7);
+        }
+        writer.write(p_0, 1);
+        writer.write(p_1, 1);
+        writer.write(indices[0], 3);
+        for (std::size_t i = 1; i < indices.size(); ++i) {
+            writer.write(indices[i], 4);
+        }
+    }
+
+    void encode_block(wga::block_format format, const wga::block_texels &texels, std::uint8_t *block) {
+        switch (format) {
+            case wga::block_format::bc1:
+                wga::encode_color_block(texels, true, block);
+                break;
+            case wga::block_format::bc3:
+                wga::encode_channel_block(texels, 3, block);
+                wga::encode_color_block(texels, false, block + 8);
+                break;
+            case wga::block_format::bc5:
+                wga::encode_channel_block(texels, 0, block);
+                wga::encode_channel_block(texels, 1, block + 8);
+                break;
+            case wga::block_format::bc7:
+                wga::encode_bc7_block(texels, block);
+                break;
+        }
+    }
+
+    // Rows of blocks are encoded in parallel on pool
+    auto compress_image(wga::thread_pool *pool, const wga::image &image, wga::block_format format)
+    -> wga::compressed_image {
+        wga::compressed_image result{format, image.width, image.height, {}};
+        const auto blocks_wide = result.blocks_wide();
+        const auto block_bytes = wga::get_block_bytes(format);
+        result.blocks.resize(std::size_t{result.bytes_per_row()} * result.blocks_high());
+        wga::parallel_rows(pool, result.blocks_high(), std::size_t{16} * image.width, [&](std::uint32_t first,
+                                                                                       std::uint32_t last) {
+            for (auto block_y = first; block_y < last; ++block_y) {
+                auto *row = result.blocks.data() + std::size_t{result.bytes_per_row()} * block_y;
+                for (std::uint32_t block_x = 0; block_x < blocks_wide; ++block_x) {
+                    wga::encode_block(format, wga::load_block(image, block_x, block_y),
+                                      row + std::size_t{block_bytes} * block_x);
+                }
+            }
+        });
+        return result;
+    }
+
+    auto compress_mip_chain(wga::thread_pool *pool, const std::vector<wga::image> &levels, wga::block_format format)
+    -> std::vector<wga::compressed_image> {
+        std::vector<wga::compressed_image> compressed;
+        compressed.reserve(levels.size());
+        for (const auto &level: levels) {
+            compressed.push_back(wga::compress_image(pool, level, format));
+        }
+        return compressed;
+    }
+}
+
+#endif //WGA_BLOCK_COMPRESSION_HPP
@@ -0,0 +1,449 @@
+#ifndef WGA_BVH_HPP
+#define WGA_BVH_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <wga/culling.hpp>
+#include <wga/thread_pool.hpp>
+#include <wga/geometry/geometry.hpp>
+
+// Bounding volume hierarchy over the world bounds of scene objects, built top down with binned SAH and stored as one
+// flat array of 32 byte nodes. Moving objects only refit the node bounds, the tree is kept until it degrades
+namespace wga {
+    static constexpr std::size_t bvh_bin_count = 16;
+    // A leaf is never split below this, and a leaf above bvh_max_leaf_size is always split
+    static constexpr std::uint32_t bvh_min_leaf_size = 2;
+    static constexpr std::uint32_t bvh_max_leaf_size = 8;
+    // Cost of visiting an interior node relative to testing one object
+    static constexpr float bvh_traversal_cost = 1.0f;
+    // Subtrees of at least this many objects are built on the thread pool
+    static constexpr std::uint32_t bvh_min_task_size = 4096;
+
+    struct bvh_node {
+        glm::vec3 min;
+        std::uint32_t first; // left child for interior nodes, the right one is first + 1; first index for leaves
+        glm::vec3 max;
+        std::uint32_t count; // objects in the leaf, 0 for interior nodes
+    };
+    static_assert(sizeof(wga::bvh_node) == 32);
+
+    // Children are always stored after their parent, so iterating nodes backwards visits children first
+    struct bvh {
+        std::vector<wga::bvh_node> nodes;
+        std::vector<std::uint32_t> indices; // object indices, every leaf refers to a contiguous range of them
+        float built_cost{0.0f}; // SAH cost right after building, see wga::get_sah_cost
+    };
+
+    struct ray {
+        glm::vec3 origin;
+        glm::vec3 direction;
+    };
+
+    struct bvh_hit {
+        std::uint32_t index; // object index
+        float distance; // along the ray, in units of its direction
+    };
+
+    auto get_empty_bounds() -> wga::geometry::bounds {
+        return {glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    }
+
+    void grow(wga::geometry::bounds &bounds, const wga::geometry::bounds &other) {
+        bounds.min = glm::min(bounds.min, other.min);
+        bounds.max = glm::max(bounds.max, other.max);
+    }
+
+    // Half the surface area, only ratios of areas are ever used
+    auto get_half_area(const wga::geometry::bounds &bounds) -> float {
+        const auto size = glm::max(bounds.max - bounds.min, glm::vec3(0.0f));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    struct bvh_split {
+        int axis{-1}; // -1 when the centers cannot be binned
+        std::size_t bin{0}; // objects in bins below go left
+        float cost{std::numeric_limits<float>::max()};
+    };
+
+    // Builds the subtrees of object ranges into node arrays, objects are reordered within their range only, so
+    // disjoint ranges can be built concurrently
+    struct bvh_builder {
+        const std::vector<wga::geometry::bounds> &bounds;
+        std::vector<glm::vec3> centers;
+        std::vector<std::uint32_t> &indices;
+
+        // A range that is left to a task, node is its placeholder in the top of the tree
+        struct task {
+            std::uint32_t node;
+            std::uint32_t begin;
+            std::uint32_t end;
+        };
+
+        auto get_bin(const wga::geometry::bounds &center_bounds, int axis, const glm::vec3 &center) const
+        -> std::size_t {
+            const auto extent = center_bounds.max[axis] - center_bounds.min[axis];
+            const auto bin = static_cast<std::size_t>(static_cast<float>(wga::bvh_bin_count) *
+                                                      (center[axis] - center_bounds.min[axis]) / extent);
+            return std::min(bin, wga::bvh_bin_count - 1);
+        }
+
+        // Cheapest split of [begin, end) over bvh_bin_count bins per axis, relative to the parent's area
+        auto find_split(std::uint32_t begin, std::uint32_t end, const wga::geometry::bounds &center_bounds,
+                        float parent_area) const -> wga::bvh_split {
+            wga::bvh_split best;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (!(center_bounds.max[axis] > center_bounds.min[axis])) {
+                    continue;
+                }
+
+                std::array<wga::geometry::bounds, wga::bvh_bin_count> bin_bounds;
+                std::array<std::uint32_t, wga::bvh_bin_count> bin_counts{};
+                bin_bounds.fill(wga::get_empty_bounds());
+                for (auto i = begin; i < end; ++i) {
+                    const auto index = indices[i];
+                    const auto bin = get_bin(center_bounds, axis, centers[index]);
+                    wga::grow(bin_bounds[bin], bounds[index]);
+                    ++bin_counts[bin];
+                }
+
+                // Cost of everything left of split plane b, then sweep from the right
+                std::array<float, wga::bvh_bin_count> left_costs{};
+                auto left = wga::get_empty_bounds();
+                std::uint32_t left_count = 0;
+                for (std::size_t b = 1; b < wga::bvh_bin_count; ++b) {
+                    wga::grow(left, bin_bounds[b - 1]);
+                    left_count += bin_counts[b - 1];
+                    left_costs[b] = left_count == 0 ? 0.0f : wga::get_half_area(left) * static_cast<float>(left_count);
+                }
+                auto right = wga::get_empty_bounds();
+                std::uint32_t right_count = 0;
+                for (auto b = wga::bvh_bin_count - 1; b > 0; --b) {
+                    wga::grow(right, bin_bounds[b]);
+                    right_count += bin_counts[b];
+                    if (right_count == 0 || right_count == end - begin) {
+                        continue;
+                    }
+                    const auto cost = wga::bvh_traversal_cost +
+                                      (left_costs[b] + wga::get_half_area(right) * static_cast<float>(right_count)) /
+                                      parent_area;
+                    if (cost < best.cost) {
+                        best = {axis, b, cost};
+                    }
+                }
+            }
+            return best;
+        }
+
+        // Makes nodes[node] the root of [begin, end), unless a range is smaller than task_size and tasks is given,
+        // then it is appended to tasks instead
+        void build(std::vector<wga::bvh_node> &nodes, std::uint32_t node, std::uint32_t begin, std::uint32_t end,
+                   std::uint32_t task_size, std::vector<task> *tasks) {
+            std::vector<task> stack{{node, begin, end}};
+            while (!stack.empty()) {
+                const auto range = stack.back();
+                stack.pop_back();
+                const auto count = range.end - range.begin;
+                if (tasks && count < task_size) {
+                    tasks->push_back(range);
+                    continue;
+                }
+
+                auto node_bounds = wga::get_empty_bounds();
+                auto center_bounds = wga::get_empty_bounds();
+                for (auto i = range.begin; i < range.end; ++i) {
+                    const auto index = indices[i];
+                    wga::grow(node_bounds, bounds[index]);
+                    center_bounds.min = glm::min(center_bounds.min, centers[index]);
+                    center_bounds.max = glm::max(center_bounds.max, centers[index]);
+                }
+                nodes[range.node] = {node_bounds.min, range.begin, node_bounds.max, count};
+                if (count <= wga::bvh_min_leaf_size) {
+                    continue;
+                }
+
+                const auto area = wga::get_half_area(node_bounds);
+                const auto split = area > 0.0f ? find_split(range.begin, range.end, center_bounds, area)
+                                               : wga::bvh_split{};
+                if (count <= wga::bvh_max_leaf_size && !(split.cost < static_cast<float>(count))) {
+                    continue;
+                }
+
+                auto *const first = indices.data() + range.begin;
+                auto *const last = indices.data() + range.end;
+                auto *middle = first;
+                if (split.axis >= 0) {
+                    middle = std::partition(first, last, [&](std::uint32_t index) {
+                        return get_bin(center_bounds, split.axis, centers[index]) < split.bin;
+                    });
+                }
+                // Coincident centers or a degenerate node, halves along the widest axis
+                if (middle == first || middle == last) {
+                    const auto size = center_bounds.max - center_bounds.min;
+                    const int axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+                    middle = first + count / 2;
+                    std::nth_element(first, middle, last, [&](std::uint32_t a, std::uint32_t b) {
+                        return centers[a][axis] < centers[b][axis];
+                    });
+                }
+
+                const auto left = static_cast<std::uint32_t>(nodes.size());
+                nodes.resize(nodes.size() + 2);
+                nodes[range.node].first = left;
+                nodes[range.node].count = 0;
+                const auto split_index = range.begin + static_cast<std::uint32_t>(middle - first);
+                stack.push_back({left + 1, split_index, range.end});
+                stack.push_back({left, range.begin, split_index});
+            }
+        }
+    };
+
+    // Expected cost of a random query relative to testing every object, grows as refits loosen the tree
+    auto get_sah_cost(const wga::bvh &bvh) -> float {
+        if (bvh.nodes.empty()) {
+            return 0.0f;
+        }
+        const auto root_area = wga::get_half_area({bvh.nodes[0].min, bvh.nodes[0].max});
+        if (!(root_area > 0.0f)) {
+            return static_cast<float>(bvh.indices.size());
+        }
+
+        float cost = 0.0f;
+        for (const auto &node: bvh.nodes) {
+            const auto area = wga::get_half_area({node.min, node.max});
+            cost += area * (node.count == 0 ? wga::bvh_traversal_cost : static_cast<float>(node.count));
+        }
+        return cost / root_area;
+    }
+
+    // Tree over the objects with the given world bounds. With a pool the top of the tree is split on this thread,
+    // the subtrees below are built as tasks and then appended to the node array
+    auto build_bvh(wga::thread_pool *pool, const std::vector<wga::geometry::bounds> &bounds) -> wga::bvh {
+        wga::bvh bvh;
+        const auto object_count = static_cast<std::uint32_t>(bounds.size());
+        if (object_count == 0) {
+            return bvh;
+        }
+
+        bvh.indices.resize(object_count);
+        for (std::uint32_t i = 0; i < object_count; ++i) {
+            bvh.indices[i] = i;
+        }
+        wga::bvh_builder builder{bounds, std::vector<glm::vec3>(object_count), bvh.indices};
+        for (std::uint32_t i = 0; i < object_count; ++i) {
+            builder.centers[i] = wga::geometry::get_center(bounds[i]);
+        }
+
+        bvh.nodes.reserve(2 * object_count / wga::bvh_min_leaf_size + 1);
+        bvh.nodes.resize(1);
+        const auto thread_count = pool ? static_cast<std::uint32_t>(pool->threads.size()) : 0u;
+        if (thread_count == 0 || object_count < 2 * wga::bvh_min_task_size) {
+            builder.build(bvh.nodes, 0, 0, object_count, 0, nullptr);
+            bvh.built_cost = wga::get_sah_cost(bvh);
+            return bvh;
+        }
+
+        // A few tasks per thread so that unbalanced splits still keep every thread busy
+        const auto task_size = std::max(wga::bvh_min_task_size, object_count / (4 * thread_count));
+        std::vector<wga::bvh_builder::task> tasks;
+        builder.build(bvh.nodes, 0, 0, object_count, task_size, &tasks);
+
+        std::vector<std::vector<wga::bvh_node>> subtrees(tasks.size());
+        std::vector<std::future<void>> futures;
+        futures.reserve(tasks.size());
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            futures.push_back(pool->submit([&builder, &subtrees, &tasks, i] {
+                const auto &task = tasks[i];
+                auto &nodes = subtrees[i];
+                nodes.reserve(2 * (task.end - task.begin) / wga::bvh_min_leaf_size + 1);
+                nodes.resize(1);
+                builder.build(nodes, 0, task.begin, task.end, 0, nullptr);
+            }));
+        }
+        // Every task has to finish before an exception leaves, they refer to builder and subtrees
+        for (auto &future: futures) {
+            future.wait();
+        }
+        for (auto &future: futures) {
+            future.get();
+        }
+
+        // The subtree root replaces its placeholder, the other nodes move to the end, children indices follow them
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            const auto &nodes = subtrees[i];
+            const auto base = static_cast<std::uint32_t>(bvh.nodes.size()) - 1;
+            const auto relocate = [base](wga::bvh_node node) {
+                if (node.count == 0) {
+                    node.first += base;
+                }
+                return node;
+            };
+            bvh.nodes[tasks[i].node] = relocate(nodes[0]);
+            for (std::size_t node = 1; node < nodes.size(); ++node) {
+                bvh.nodes.push_back(relocate(nodes[node]));
+            }
+        }
+        bvh.built_cost = wga::get_sah_cost(bvh);
+        return bvh;
+    }
+
+    // Recomputes the node bounds bottom up after objects moved, the topology is kept
+    void refit_bvh(wga::bvh &bvh, const std::vector<wga::geometry::bounds> &bounds) {
+        for (auto i = bvh.nodes.size(); i-- > 0;) {
+            auto &node = bvh.nodes[i];
+            auto node_bounds = wga::get_empty_bounds();
+            if (node.count > 0) {
+                for (auto index = node.first; index < node.first + node.count; ++index) {
+                    wga::grow(node_bounds, bounds[bvh.indices[index]]);
+                }
+            } else {
+                for (auto child = node.first; child < node.first + 2; ++child) {
+                    wga::grow(node_bounds, {bvh.nodes[child].min, bvh.nodes[child].max});
+                }
+            }
+            node.min = node_bounds.min;
+            node.max = node_bounds.max;
+        }
+    }
+
+    // Clears the bits of mask for the planes the box is completely inside of, false when it is outside one of them
+    auto test_planes(const wga::frustum &frustum, const glm::vec3 &min, const glm::vec3 &max,
+                     std::uint32_t &mask) -> bool {
+        const auto center = (min + max) * 0.5f;
+        const auto extent = (max - min) * 0.5f;
+        for (std::uint32_t plane = 0; plane < 6; ++plane) {
+            if (!(mask >> plane & 1u)) {
+                continue;
+            }
+            const auto &p = frustum.planes[plane];
+            const auto distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+            const auto reach = std::abs(p.x) * extent.x + std::abs(p.y) * extent.y + std::abs(p.z) * extent.z;
+            if (distance + reach < 0.0f) {
+                return false;
+            }
+            if (distance - reach >= 0.0f) {
+                mask &= ~(1u << plane);
+            }
+        }
+        return true;
+    }
+
+    // Indices of the objects whose bounds intersect frustum, in tree order. Planes a node is fully inside of are not
+    // tested again below it, subtrees inside all six are taken without any test
+    void cull_bvh(const wga::frustum &frustum, const wga::bvh &bvh, const std::vector<wga::geometry::bounds> &bounds,
+                  std::vector<std::uint32_t> &visible) {
+        visible.clear();
+        if (bvh.nodes.empty()) {
+            return;
+        }
+
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> stack; // node, planes still to test
+        stack.reserve(64);
+        stack.emplace_back(0u, 0x3fu);
+        while (!stack.empty()) {
+            auto [index, mask] = stack.back();
+            stack.pop_back();
+            const auto &node = bvh.nodes[index];
+            if (mask != 0 && !wga::test_planes(frustum, node.min, node.max, mask)) {
+                continue;
+            }
+
+            if (node.count == 0) {
+                stack.emplace_back(node.first + 1, mask);
+                stack.emplace_back(node.first, mask);
+                continue;
+            }
+            for (auto i = node.first; i < node.first + node.count; ++i) {
+                const auto object = bvh.indices[i];
+                auto object_mask = mask;
+                if (object_mask == 0 ||
+                    wga::test_planes(frustum, bounds[object].min, bounds[object].max, object_mask)) {
+                    visible.push_back(object);
+                }
+            }
+        }
+    }
+
+    // Distance along ray to where it enters the box, or infinity when it misses it or the box is past max_distance
+    auto intersect_box(const glm::vec3 &origin, const glm::vec3 &inverse_direction, const glm::vec3 &min,
+                       const glm::vec3 &max, float max_distance) -> float {
+        const auto t0 = (min - origin) * inverse_direction;
+        const auto t1 = (max - origin) * inverse_direction;
+        const auto lower = glm::min(t0, t1);
+        const auto upper = glm::max(t0, t1);
+        const auto entry = std::max(std::max(lower.x, lower.y), std::max(lower.z, 0.0f));
+        const auto exit = std::min(std::min(upper.x, upper.y), std::min(upper.z, max_distance));
+        return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+    }
+
+    // Closest object whose bounds ray hits, children are visited near to far so farther subtrees are mostly skipped
+    auto intersect_bvh(const wga::bvh &bvh, const std::vector<wga::geometry::bounds> &bounds, const wga::ray &ray,
+                       float max_distance = std::numeric_limits<float>::max()) -> std::optional<wga::bvh_hit> {
+        std::optional<wga::bvh_hit> hit;
+        if (bvh.nodes.empty()) {
+            return hit;
+        }
+
+        const auto inverse_direction = 1.0f / ray.direction;
+        auto closest = max_distance;
+        const auto root_distance = wga::intersect_box(ray.origin, inverse_direction, bvh.nodes[0].min,
+                                                      bvh.nodes[0].max, closest);
+        if (std::isinf(root_distance)) {
+            return hit;
+        }
+
+        std::vector<std::pair<std::uint32_t, float>> stack; // node, entry distance
+        stack.reserve(64);
+        stack.emplace_back(0u, root_distance);
+        while (!stack.empty()) {
+            const auto [index, distance] = stack.back();
+            stack.pop_back();
+            if (distance > closest) {
+                continue;
+            }
+
+            const auto &node = bvh.nodes[index];
+            if (node.count > 0) {
+                for (auto i = node.first; i < node.first + node.count; ++i) {
+                    const auto object = bvh.indices[i];
+                    const auto object_distance = wga::intersect_box(ray.origin, inverse_direction, bounds[object].min,
+                                                                    bounds[object].max, closest);
+                    if (object_distance <= closest) {
+                        closest = object_distance;
+                        hit = wga::bvh_hit{object, object_distance};
+                    }
+                }
+                continue;
+            }
+
+            const auto &left = bvh.nodes[node.first];
+            const auto &right = bvh.nodes[node.first + 1];
+            auto first = std::pair{node.first, wga::intersect_box(ray.origin, inverse_direction, left.min, left.max,
+                                                                 closest)};
+            auto second = std::pair{node.first + 1, wga::intersect_box(ray.origin, inverse_direction, right.min,
+                                                                    right.max, closest)};
+            if (second.second < first.second) {
+                std::swap(first, second);
+            }
+            if (!std::isinf(second.second)) {
+                stack.push_back(second);
+            }
+            if (!std::isinf(first.second)) {
+                stack.push_back(first);
+            }
+        }
+        return hit;
+    }
+}
+
+#endif //WGA_BVH_HPP
@@ -0,0 +1,241 @@
+#ifndef WGA_CULLING_HPP
+#define WGA_CULLING_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WGA_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define WGA_CULLING_AVX
+#include <immintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <wga/thread_pool.hpp>
+#include <wga/geometry/geometry.hpp>
+
+// CPU frustum culling: world space bounds of all objects in SoA arrays, tested 8 (AVX) or 4 (SSE) objects at a time
+// against the camera frustum, only the indices of the survivors are kept for encoding
+namespace wga {
+    // Objects per task when culling on a thread pool, below this one task tests everything
+    static constexpr std::size_t cull_batch_size = 16384;
+    // Arrays are padded to the widest SIMD batch
+    static constexpr std::size_t cull_padding = 8;
+
+    // Planes as (normal, distance) with normals pointing inwards, p is inside when dot(normal, p) + distance >= 0
+    struct frustum {
+        std::array<glm::vec4, 6> planes;
+    };
+
+    // Gribb-Hartmann extraction from view_projection, with depth clipped to [0, w] like WebGPU does
+    auto get_frustum(const glm::mat4x4 &view_projection) -> wga::frustum {
+        const auto row = [&view_projection](int i) {
+            return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i],
+                             view_projection[3][i]);
+        };
+        const auto x = row(0);
+        const auto y = row(1);
+        const auto z = row(2);
+        const auto w = row(3);
+
+        wga::frustum frustum{{w + x, w - x, w + y, w - y, z, w - z}};
+        for (auto &plane: frustum.planes) {
+            const auto length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            if (length > 0.0f) {
+                plane = plane * (1.0f / length);
+            }
+        }
+        return frustum;
+    }
+
+    // A sphere and an axis aligned box sharing one center per object. An object is culled when either is outside
+    // a plane, per plane the smaller of the two extents is used
+    struct cull_bounds {
+        std::vector<float> center_x;
+        std::vector<float> center_y;
+        std::vector<float> center_z;
+        std::vector<float> radius;
+        std::vector<float> extent_x; // half sizes of the box
+        std::vector<float> extent_y;
+        std::vector<float> extent_z;
+        std::size_t count{0};
+
+        void resize(std::size_t object_count) {
+            count = object_count;
+            const auto padded = (object_count + wga::cull_padding - 1) / wga::cull_padding * wga::cull_padding;
+            for (auto *array: {&center_x, &center_y, &center_z, &radius, &extent_x, &extent_y, &extent_z}) {
+                array->resize(padded, 0.0f);
+            }
+        }
+
+        // World bounds of object index from its local bounds and the radius of its bounding sphere around their
+        // center, see wga::geometry::compute_bounding_radius
+        void set(std::size_t index, const glm::mat4x4 &transform, const wga::geometry::bounds &bounds,
+                 float bounds_radius) {
+            const auto local_center = wga::geometry::get_center(bounds);
+            const auto local_extent = (bounds.max - bounds.min) * 0.5f;
+
+            float max_scale_squared = 0.0f;
+            std::array<float, 3> center{};
+            std::array<float, 3> extent{};
+            for (int axis = 0; axis < 3; ++axis) {
+                center[static_cast<std::size_t>(axis)] = transform[3][axis];
+            }
+            for (int column = 0; column < 3; ++column) {
+                float scale_squared = 0.0f;
+                for (int axis = 0; axis < 3; ++axis) {
+                    const auto value = transform[column][axis];
+                    center[static_cast<std::size_t>(axis)] += value * local_center[column];
+                    // The box of the transformed box, Arvo's method
+                    extent[static_cast<std::size_t>(axis)] += std::abs(value) * local_extent[column];
+                    scale_squared += value * value;
+                }
+                max_scale_squared = std::max(max_scale_squared, scale_squared);
+            }
+
+            center_x[index] = center[0];
+            center_y[index] = center[1];
+            center_z[index] = center[2];
+            radius[index] = bounds_radius * std::sqrt(max_scale_squared);
+            extent_x[index] = extent[0];
+            extent_y[index] = extent[1];
+            extent_z[index] = extent[2];
+        }
+    };
+
+    // Reference test of objects [first, last), appends the survivors to visible
+    void cull_scalar(const wga::frustum &frustum, const wga::cull_bounds &bounds, std::size_t first, std::size_t last,
+                     std::vector<std::uint32_t> &visible) {
+        for (auto i = first; i < last; ++i) {
+            bool inside = true;
+            for (const auto &plane: frustum.planes) {
+                const auto distance = plane.x * bounds.center_x[i] + plane.y * bounds.center_y[i] +
+                                      plane.z * bounds.center_z[i] + plane.w;
+                const auto box_extent = std::abs(plane.x) * bounds.extent_x[i] +
+                                        std::abs(plane.y) * bounds.extent_y[i] +
+                                        std::abs(plane.z) * bounds.extent_z[i];
+                inside = inside && distance + std::min(bounds.radius[i], box_extent) >= 0.0f;
+            }
+            if (inside) {
+                visible.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+    }
+
+    // Appends the set bits of mask as indices first + bit, bits at or past last are padding
+    void append_visible(std::uint32_t mask, std::size_t first, std::size_t last, std::vector<std::uint32_t> &visible) {
+        for (std::size_t bit = 0; mask >> bit != 0 && first + bit < last; ++bit) {
+            if (mask >> bit & 1u) {
+                visible.push_back(static_cast<std::uint32_t>(first + bit));
+            }
+        }
+    }
+
+    // SIMD test of objects [first, last), first must be a multiple of cull_padding
+    void cull_range(const wga::frustum &frustum, const wga::cull_bounds &bounds, std::size_t first, std::size_t last,
+                    std::vector<std::uint32_t> &visible) {
+#if defined(WGA_CULLING_AVX)
+        const auto sign_mask = _mm256_set1_ps(-0.0f);
+        for (auto i = first; i < last; i += 8) {
+            const auto center_x = _mm256_loadu_ps(bounds.center_x.data() + i);
+            const auto center_y = _mm256_loadu_ps(bounds.center_y.data() + i);
+            const auto center_z = _mm256_loadu_ps(bounds.center_z.data() + i);
+            const auto radius = _mm256_loadu_ps(bounds.radius.data() + i);
+            const auto extent_x = _mm256_loadu_ps(bounds.extent_x.data() + i);
+            const auto extent_y = _mm256_loadu_ps(bounds.extent_y.data() + i);
+            const auto extent_z = _mm256_loadu_ps(bounds.extent_z.data() + i);
+            auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const auto &plane: frustum.planes) {
+                const auto normal_x = _mm256_set1_ps(plane.x);
+                const auto normal_y = _mm256_set1_ps(plane.y);
+                const auto normal_z = _mm256_set1_ps(plane.z);
+                const auto distance = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(normal_x, center_x), _mm256_mul_ps(normal_y, center_y)),
+                        _mm256_add_ps(_mm256_mul_ps(normal_z, center_z), _mm256_set1_ps(plane.w)));
+                const auto box_extent = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign_mask, normal_x), extent_x),
+                                      _mm256_mul_ps(_mm256_andnot_ps(sign_mask, normal_y), extent_y)),
+                        _mm256_mul_ps(_mm256_andnot_ps(sign_mask, normal_z), extent_z));
+                const auto reach = _mm256_add_ps(distance, _mm256_min_ps(radius, box_extent));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(reach, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            wga::append_visible(static_cast<std::uint32_t>(_mm256_movemask_ps(inside)), i, last, visible);
+        }
+#elif defined(WGA_CULLING_SSE)
+        const auto sign_mask = _mm_set1_ps(-0.0f);
+        for (auto i = first; i < last; i += 4) {
+            const auto center_x = _mm_loadu_ps(bounds.center_x.data() + i);
+            const auto center_y = _mm_loadu_ps(bounds.center_y.data() + i);
+            const auto center_z = _mm_loadu_ps(bounds.center_z.data() + i);
+            const auto radius = _mm_loadu_ps(bounds.radius.data() + i);
+            const auto extent_x = _mm_loadu_ps(bounds.extent_x.data() + i);
+            const auto extent_y = _mm_loadu_ps(bounds.extent_y.data() + i);
+            const auto extent_z = _mm_loadu_ps(bounds.extent_z.data() + i);
+            auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const auto &plane: frustum.planes) {
+                const auto normal_x = _mm_set1_ps(plane.x);
+                const auto normal_y = _mm_set1_ps(plane.y);
+                const auto normal_z = _mm_set1_ps(plane.z);
+                const auto distance = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(normal_x, center_x), _mm_mul_ps(normal_y, center_y)),
+                        _mm_add_ps(_mm_mul_ps(normal_z, center_z), _mm_set1_ps(plane.w)));
+                const auto box_extent = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, normal_x), extent_x),
+                                   _mm_mul_ps(_mm_andnot_ps(sign_mask, normal_y), extent_y)),
+                        _mm_mul_ps(_mm_andnot_ps(sign_mask, normal_z), extent_z));
+                const auto reach = _mm_add_ps(distance, _mm_min_ps(radius, box_extent));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(reach, _mm_setzero_ps()));
+            }
+            wga::append_visible(static_cast<std::uint32_t>(_mm_movemask_ps(inside)), i, last, visible);
+        }
+#else
+        wga::cull_scalar(frustum, bounds, first, last, visible);
+#endif
+    }
+
+    // Indices of the objects intersecting frustum in ascending order, batches run on pool if one is given
+    void cull(wga::thread_pool *pool, const wga::frustum &frustum, const wga::cull_bounds &bounds,
+              std::vector<std::uint32_t> &visible) {
+        visible.clear();
+        visible.reserve(bounds.count);
+        if (!pool || bounds.count <= wga::cull_batch_size) {
+            wga::cull_range(frustum, bounds, 0, bounds.count, visible);
+            return;
+        }
+
+        std::vector<std::vector<std::uint32_t>> batches((bounds.count + wga::cull_batch_size - 1) /
+                                                        wga::cull_batch_size);
+        std::vector<std::future<void>> futures;
+        futures.reserve(batches.size());
+        for (std::size_t batch = 0; batch < batches.size(); ++batch) {
+            futures.push_back(pool->submit([&frustum, &bounds, &batches, batch] {
+                const auto first = batch * wga::cull_batch_size;
+                batches[batch].reserve(wga::cull_batch_size);
+                wga::cull_range(frustum, bounds, first, std::min(bounds.count, first + wga::cull_batch_size),
+                                batches[batch]);
+            }));
+        }
+        // Every batch has to finish before an exception leaves this frame, they refer to batches
+        for (auto &future: futures) {
+            future.wait();
+        }
+        for (auto &future: futures) {
+            future.get();
+        }
+        for (const auto &batch: batches) {
+            visible.insert(visible.end(), batch.begin(), batch.end());
+        }
+    }
+}
+
+#endif //WGA_CULLING_HPP
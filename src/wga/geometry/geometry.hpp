@@ -5,75 +5,269 @@
 #ifndef WGA_GEOMETRY_HPP
 #define WGA_GEOMETRY_HPP
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <limits>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include <wga/shader_types.hpp>
+#include <wga/mapped_file.hpp>
+#include <wga/geometry/obj.hpp>
+#include <wga/geometry/text.hpp>
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
 namespace wga::geometry {
+    enum class Section {
+        None,
+        Points,
+        Indices,
+    };
+
+    // Classifies a line of the [points]/[indices] format, cursor is left on the first non blank character
+    auto get_section_line(const char *&cursor, const char *end, Section &currentSection) noexcept -> bool {
+        cursor = text::skip_blanks(cursor, end);
+        std::string_view line(cursor, static_cast<std::size_t>(end - cursor));
+        while (!line.empty() && text::is_blank(line.back())) {
+            line.remove_suffix(1);
+        }
+
+        if (line == "[points]") {
+            currentSection = Section::Points;
+            return false;
+        } else if (line == "[indices]") {
+            currentSection = Section::Indices;
+            return false;
+        }
+
+        // Comments and empty lines carry no data
+        return !line.empty() && line[0] != '#';
+    }
+
     // https://eliemichel.github.io/LearnWebGPU/basic-3d-rendering/input-geometry/loading-from-file.html
+    // Parses the mapped file in place: a first pass counts the data lines so that both vectors are sized once
     bool load(const std::filesystem::path &path, std::vector<float> &pointData,
               std::vector<uint32_t> &indexData, int dimensions) {
-        std::ifstream file(path);
-        if (!file.is_open()) {
+        std::optional<wga::mapped_file> file;
+        try {
+            file.emplace(path);
+        } catch (const std::runtime_error &) {
             return false;
         }
 
-        pointData.clear();
-        indexData.clear();
+        const char *const first = file->data();
+        const char *const last = first + file->size();
+        const auto point_size = static_cast<std::size_t>(dimensions + 3);
 
-        enum class Section {
-            None,
-            Points,
-            Indices,
-        };
+        std::size_t point_lines = 0;
+        std::size_t index_lines = 0;
         Section currentSection = Section::None;
+        for (const char *line = first; line < last;) {
+            const char *end = text::line_end(line, last);
+            const char *cursor = line;
+            if (get_section_line(cursor, end, currentSection)) {
+                point_lines += currentSection == Section::Points;
+                index_lines += currentSection == Section::Indices;
+            }
+            line = end + 1;
+        }
 
-        float value;
-        uint16_t index;
-        std::string line;
-        while (!file.eof()) {
-            getline(file, line);
+        pointData.resize(point_lines * point_size);
+        indexData.resize(index_lines * 3);
 
-            // overcome the `CRLF` problem
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
+        float *point = pointData.data();
+        std::uint32_t *index = indexData.data();
+        std::size_t line_number = 1;
+        currentSection = Section::None;
+        for (const char *line = first; line < last; ++line_number) {
+            const char *end = text::line_end(line, last);
+            const char *cursor = line;
 
-            if (line == "[points]") {
-                currentSection = Section::Points;
-            } else if (line == "[indices]") {
-                currentSection = Section::Indices;
-            } else if (line[0] == '#' || line.empty()) {
-                // Do nothing, this is a comment
-            } else if (currentSection == Section::Points) {
-                std::istringstream iss(line);
-                // Get x, y, [z], r, g, b
-                for (int i = 0; i < dimensions + 3; ++i) {
-                    iss >> value;
-                    pointData.push_back(value);
+            if (get_section_line(cursor, end, currentSection)) {
+                bool ok = true;
+                if (currentSection == Section::Points) {
+                    // Get x, y, [z], r, g, b
+                    for (std::size_t i = 0; ok && i < point_size; ++i) {
+                        ok = text::parse_number(cursor, end, *point++);
+                    }
+                } else if (currentSection == Section::Indices) {
+                    // Get corners #0 #1 and #2
+                    for (std::size_t i = 0; ok && i < 3; ++i) {
+                        ok = text::parse_number(cursor, end, *index++);
+                    }
                 }
-            } else if (currentSection == Section::Indices) {
-                std::istringstream iss(line);
-                // Get corners #0 #1 and #2
-                for (int i = 0; i < 3; ++i) {
-                    iss >> index;
-                    indexData.push_back(index);
+
+                if (!ok || (currentSection != Section::None && text::skip_blanks(cursor, end) != end)) {
+                    std::cerr << path.string() << ':' << line_number << ": malformed "
+                              << (currentSection == Section::Points ? "point" : "index") << " line\n";
+                    return false;
                 }
             }
+
+            line = end + 1;
         }
+
         return true;
     }
 
-    // https://eliemichel.github.io/LearnWebGPU/basic-3d-rendering/3d-meshes/loading-from-file.html
-    bool load_obj(const std::filesystem::path& path, std::vector<wga::shader_type::vertex_attributes>& vertex_data)
-    {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
+    struct bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // Axis aligned bounds of the x, y, [z] positions of the [points]/[indices] format
+    auto compute_bounds(const std::vector<float> &point_data, int dimensions) -> bounds {
+        const auto point_size = static_cast<std::size_t>(dimensions + 3);
+        if (point_data.size() < point_size) {
+            return {glm::vec3(0.0f), glm::vec3(0.0f)};
+        }
+
+        bounds result{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+        if (dimensions < 3) {
+            result.min.z = result.max.z = 0.0f;
+        }
+        for (std::size_t i = 0; i + point_size <= point_data.size(); i += point_size) {
+            for (int axis = 0; axis < std::min(dimensions, 3); ++axis) {
+                const float value = point_data[i + static_cast<std::size_t>(axis)];
+                result.min[axis] = std::min(result.min[axis], value);
+                result.max[axis] = std::max(result.max[axis], value);
+            }
+        }
+        return result;
+    }
+
+    auto compute_bounds(const std::vector<wga::shader_type::vertex_attributes> &vertex_data) -> bounds {
+        if (vertex_data.empty()) {
+            return {glm::vec3(0.0f), glm::vec3(0.0f)};
+        }
+
+        bounds result{vertex_data[0].position, vertex_data[0].position};
+        for (const auto &vertex: vertex_data) {
+            result.min = glm::min(result.min, vertex.position);
+            result.max = glm::max(result.max, vertex.position);
+        }
+        return result;
+    }
+
+    auto get_center(const bounds &bounds) -> glm::vec3 {
+        return (bounds.min + bounds.max) * 0.5f;
+    }
+
+    // Axis aligned bounds of bounds after transform, Arvo's method
+    auto transform_bounds(const glm::mat4x4 &transform, const bounds &bounds) -> wga::geometry::bounds {
+        const auto local_center = wga::geometry::get_center(bounds);
+        const auto local_extent = (bounds.max - bounds.min) * 0.5f;
+
+        auto center = glm::vec3(transform[3]);
+        glm::vec3 extent(0.0f);
+        for (int column = 0; column < 3; ++column) {
+            center += glm::vec3(transform[column]) * local_center[column];
+            extent += glm::abs(glm::vec3(transform[column])) * local_extent[column];
+        }
+        return {center - extent, center + extent};
+    }
+
+    // Radius of the bounding sphere around the center of bounds, reaches the farthest point instead of the corner of
+    // the box, so it is never larger than the box's half diagonal
+    auto compute_bounding_radius(const std::vector<float> &point_data, int dimensions, const bounds &bounds) -> float {
+        const auto point_size = static_cast<std::size_t>(dimensions + 3);
+        const auto center = wga::geometry::get_center(bounds);
+        float radius_squared = 0.0f;
+        for (std::size_t i = 0; i + point_size <= point_data.size(); i += point_size) {
+            float distance_squared = 0.0f;
+            for (int axis = 0; axis < std::min(dimensions, 3); ++axis) {
+                const float offset = point_data[i + static_cast<std::size_t>(axis)] - center[axis];
+                distance_squared += offset * offset;
+            }
+            radius_squared = std::max(radius_squared, distance_squared);
+        }
+        return std::sqrt(radius_squared);
+    }
+
+    auto compute_bounding_radius(const std::vector<wga::shader_type::vertex_attributes> &vertex_data,
+                                 const bounds &bounds) -> float {
+        const auto center = wga::geometry::get_center(bounds);
+        float radius_squared = 0.0f;
+        for (const auto &vertex: vertex_data) {
+            const auto offset = vertex.position - center;
+            radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+        }
+        return std::sqrt(radius_squared);
+    }
+
+    // Hashes the raw bits of a vertex, so that only bitwise identical corners are welded together
+    struct vertex_attributes_hash {
+        auto operator()(const wga::shader_type::vertex_attributes &vertex) const noexcept -> std::size_t {
+            static_assert(sizeof(vertex) % sizeof(std::uint32_t) == 0);
+            std::array<std::uint32_t, sizeof(vertex) / sizeof(std::uint32_t)> words{};
+            std::memcpy(words.data(), &vertex, sizeof(vertex));
+
+            std::size_t seed = 0;
+            for (auto word: words) {
+                seed ^= std::hash<std::uint32_t>{}(word) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
+    struct vertex_attributes_equal {
+        auto operator()(const wga::shader_type::vertex_attributes &lhs,
+                        const wga::shader_type::vertex_attributes &rhs) const noexcept -> bool {
+            return std::memcmp(&lhs, &rhs, sizeof(wga::shader_type::vertex_attributes)) == 0;
+        }
+    };
+
+    // Works on both tinyobj::attrib_t and wga::geometry::obj_data, which share the same layout
+    template<typename Attrib, typename Index>
+    auto make_vertex(const Attrib &attrib, const Index &idx) {
+        wga::shader_type::vertex_attributes vertex{};
+
+        // +X+Y+Z => +X-Z+Y
+        const auto vi = static_cast<std::size_t>(idx.vertex_index);
+        vertex.position = {
+                attrib.vertices[3 * vi + 0],
+                -attrib.vertices[3 * vi + 2],
+                attrib.vertices[3 * vi + 1]
+        };
+
+        if (idx.normal_index >= 0) {
+            const auto ni = static_cast<std::size_t>(idx.normal_index);
+            vertex.normal = {
+                    attrib.normals[3 * ni + 0],
+                    -attrib.normals[3 * ni + 2],
+                    attrib.normals[3 * ni + 1]
+            };
+        }
+
+        const auto ci = vi;
+        vertex.color = {
+                attrib.colors[3 * ci + 0],
+                attrib.colors[3 * ci + 1],
+                attrib.colors[3 * ci + 2]
+        };
+
+        if (idx.texcoord_index >= 0) {
+            const auto ui = static_cast<std::size_t>(idx.texcoord_index);
+            vertex.uv = {
+                    attrib.texcoords[2 * ui + 0],
+                    1 - attrib.texcoords[2 * ui + 1],
+            };
+        }
+
+        return vertex;
+    }
+
+    // Reference reader, load_obj goes through the native parse_obj instead, wga_bench compares the two
+    bool read_obj_tinyobj(const std::filesystem::path &path, tinyobj::attrib_t &attrib,
+                          std::vector<tinyobj::shape_t> &shapes) {
         std::vector<tinyobj::material_t> materials;
 
         std::string warn;
@@ -100,43 +294,53 @@ namespace wga::geometry {
             std::clog << "No shapes in file!\n";
         }
 
+        return true;
+    }
+
+    // https://eliemichel.github.io/LearnWebGPU/basic-3d-rendering/3d-meshes/loading-from-file.html
+    bool load_obj(const std::filesystem::path& path, std::vector<wga::shader_type::vertex_attributes>& vertex_data)
+    {
+        wga::geometry::obj_data data;
+        if (!wga::geometry::parse_obj(path, data)) {
+            return false;
+        }
+
+        vertex_data.resize(data.indices.size());
+        for (std::size_t i = 0; i < data.indices.size(); ++i) {
+            vertex_data[i] = make_vertex(data, data.indices[i]);
+        }
+
+        return true;
+    }
+
+    // Indexed variant of load_obj, identical face corners are welded into a single vertex
+    bool load_obj(const std::filesystem::path &path, std::vector<wga::shader_type::vertex_attributes> &vertex_data,
+                  std::vector<std::uint32_t> &index_data) {
+        wga::geometry::obj_data data;
+        if (!wga::geometry::parse_obj(path, data)) {
+            return false;
+        }
+
+        const std::size_t corner_count = data.indices.size();
+        const std::size_t position_count = data.vertices.size() / 3;
+
         vertex_data.clear();
-        for(const auto& shape : shapes) {
-            const std::size_t offset = vertex_data.size();
-            const std::size_t size = shape.mesh.indices.size();
-            vertex_data.resize(offset + size);
-
-            for (std::size_t i = 0; i < size; ++i) {
-                const auto &idx = shape.mesh.indices[i];
-
-                // +X+Y+Z => +X-Z+Y
-                const auto vi = static_cast<std::size_t>(idx.vertex_index);
-                vertex_data[offset + i].position = {
-                        attrib.vertices[3 * vi + 0],
-                        -attrib.vertices[3 * vi + 2],
-                        attrib.vertices[3 * vi + 1]
-                };
-
-                const auto ni = static_cast<std::size_t>(idx.normal_index);
-                vertex_data[offset + i].normal = {
-                        attrib.normals[3 * ni + 0],
-                        -attrib.normals[3 * ni + 2],
-                        attrib.normals[3 * ni + 1]
-                };
-
-                const auto ci = vi;
-                vertex_data[offset + i].color = {
-                        attrib.colors[3 * ci + 0],
-                        attrib.colors[3 * ci + 1],
-                        attrib.colors[3 * ci + 2]
-                };
-
-                const auto ui = static_cast<std::size_t>(idx.texcoord_index);
-                vertex_data[offset + i].uv = {
-                        attrib.texcoords[2 * ui + 0],
-                        1 - attrib.texcoords[2 * ui + 1],
-                };
+        index_data.clear();
+        vertex_data.reserve(position_count);
+        index_data.reserve(corner_count);
+
+        std::unordered_map<wga::shader_type::vertex_attributes, std::uint32_t,
+                vertex_attributes_hash, vertex_attributes_equal> unique_vertices;
+        unique_vertices.reserve(position_count);
+
+        for (const auto &idx: data.indices) {
+            const auto vertex = make_vertex(data, idx);
+            auto [it, inserted] = unique_vertices.try_emplace(
+                    vertex, static_cast<std::uint32_t>(vertex_data.size()));
+            if (inserted) {
+                vertex_data.push_back(vertex);
             }
+            index_data.push_back(it->second);
         }
 
         return true;
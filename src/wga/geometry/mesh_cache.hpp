@@ -0,0 +1,227 @@
+#ifndef WGA_GEOMETRY_MESH_CACHE_HPP
+#define WGA_GEOMETRY_MESH_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <wga/mapped_file.hpp>
+
+// Binary .wgamesh container: a fixed header, the source path it was imported from,
+// then the vertex and index payloads exactly as they are uploaded to the GPU
+namespace wga::geometry {
+    static constexpr char mesh_cache_magic[8] = {'W', 'G', 'A', 'M', 'E', 'S', 'H', '\0'};
+    static constexpr std::uint32_t mesh_cache_version = 3;
+    static constexpr std::uint64_t mesh_cache_alignment = 16;
+
+    enum class mesh_layout : std::uint32_t {
+        vertex_attributes = 1, // wga::shader_type::vertex_attributes
+        points = 2,            // x, y, [z], r, g, b floats of the [points]/[indices] format
+    };
+
+    enum class mesh_index_format : std::uint32_t {
+        none = 0,
+        uint16 = 1,
+        uint32 = 2,
+    };
+
+    struct mesh_header {
+        char magic[8];
+        std::uint32_t version;
+        mesh_layout vertex_layout;
+        std::uint32_t vertex_stride;
+        std::uint32_t vertex_format; // wga::vertex_format::code() of mesh_layout::vertex_attributes payloads
+        mesh_index_format index_format;
+        std::uint32_t reserved;
+        std::uint64_t vertex_count;
+        std::uint64_t index_count;
+        float bounds_min[3];
+        float bounds_max[3];
+        float bounds_radius; // bounding sphere around the center of the bounds
+        std::uint32_t reserved_bounds;
+        std::int64_t source_time;
+        std::uint64_t source_path_size;
+        std::uint64_t vertex_offset;
+        std::uint64_t vertex_size;
+        std::uint64_t index_offset;
+        std::uint64_t index_size;
+    };
+
+    struct mesh_cache {
+        std::unique_ptr<wga::mapped_file> file;
+        mesh_header header;
+
+        [[nodiscard]] auto vertex_data() const noexcept -> const char * {
+            return file->data() + header.vertex_offset;
+        }
+
+        [[nodiscard]] auto index_data() const noexcept -> const char * {
+            return file->data() + header.index_offset;
+        }
+    };
+
+    auto get_mesh_cache_path(const std::filesystem::path &source) {
+        auto path = source;
+        path += ".wgamesh";
+        return path;
+    }
+
+    auto get_source_time(const std::filesystem::path &source, std::error_code &error) -> std::int64_t {
+        const auto time = std::filesystem::last_write_time(source, error);
+        return static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+
+    auto get_source_key(const std::filesystem::path &source) {
+        std::error_code error;
+        auto key = std::filesystem::weakly_canonical(source, error);
+        return (error ? source : key).generic_string();
+    }
+
+    // Bytes per index of format, 0 for meshes without indices or unknown formats
+    auto get_index_size(mesh_index_format format) noexcept -> std::uint64_t {
+        switch (format) {
+            case mesh_index_format::uint16:
+                return 2;
+            case mesh_index_format::uint32:
+                return 4;
+            case mesh_index_format::none:
+            default:
+                return 0;
+        }
+    }
+
+    // True when the size bytes at offset lie inside a file of file_size bytes, without overflowing
+    auto is_in_file(std::uint64_t offset, std::uint64_t size, std::uint64_t file_size) noexcept -> bool {
+        return offset <= file_size && size <= file_size - offset;
+    }
+
+    auto align_mesh_offset(std::uint64_t offset) noexcept -> std::uint64_t {
+        return (offset + mesh_cache_alignment - 1) / mesh_cache_alignment * mesh_cache_alignment;
+    }
+
+    // Returns the mapped cache of source, if it exists, matches the expected layout and is not older than the source
+    auto open_mesh_cache(const std::filesystem::path &source, mesh_layout layout, std::uint32_t vertex_format,
+                         std::uint32_t vertex_stride) -> std::optional<mesh_cache> {
+        const auto path = get_mesh_cache_path(source);
+
+        std::error_code error;
+        const auto source_time = get_source_time(source, error);
+        if (error || !std::filesystem::exists(path, error)) {
+            return std::nullopt;
+        }
+
+        mesh_cache cache{};
+        try {
+            cache.file = std::make_unique<wga::mapped_file>(path);
+        } catch (const std::runtime_error &) {
+            return std::nullopt;
+        }
+
+        const auto size = cache.file->size();
+        if (size < sizeof(mesh_header)) {
+            return std::nullopt;
+        }
+        std::memcpy(&cache.header, cache.file->data(), sizeof(mesh_header));
+
+        const auto &header = cache.header;
+        const auto key = get_source_key(source);
+        const bool valid = std::memcmp(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic)) == 0 &&
+                           header.version == mesh_cache_version &&
+                           header.vertex_layout == layout &&
+                           header.vertex_stride == vertex_stride &&
+                           header.vertex_format == vertex_format &&
+                           header.source_time == source_time &&
+                           header.source_path_size == key.size() &&
+                           sizeof(mesh_header) + key.size() <= size &&
+                           key.compare(0, key.size(), cache.file->data() + sizeof(mesh_header), key.size()) == 0 &&
+                           (header.index_format == mesh_index_format::none ||
+                            header.index_format == mesh_index_format::uint16 ||
+                            header.index_format == mesh_index_format::uint32) &&
+                           header.vertex_count <= size / std::max<std::uint64_t>(vertex_stride, 1) &&
+                           header.vertex_size == header.vertex_count * vertex_stride &&
+                           header.index_count <= size &&
+                           header.index_size == header.index_count * get_index_size(header.index_format) &&
+                           is_in_file(header.vertex_offset, header.vertex_size, size) &&
+                           is_in_file(header.index_offset, header.index_size, size);
+
+        if (!valid) {
+            std::clog << "Ignoring stale mesh cache " << path.string() << '\n';
+            return std::nullopt;
+        }
+
+        return cache;
+    }
+
+    // Writes the GPU ready payloads of source next to it, failures are only logged since the cache is optional
+    bool write_mesh_cache(const std::filesystem::path &source, mesh_header header,
+                          const void *vertex_data, const void *index_data) {
+        const auto path = get_mesh_cache_path(source);
+
+        std::error_code error;
+        header.source_time = get_source_time(source, error);
+        if (error) {
+            return false;
+        }
+
+        const auto key = get_source_key(source);
+        std::memcpy(header.magic, mesh_cache_magic, sizeof(mesh_cache_magic));
+        header.version = mesh_cache_version;
+        header.source_path_size = key.size();
+        header.vertex_offset = align_mesh_offset(sizeof(mesh_header) + key.size());
+        header.index_offset = align_mesh_offset(header.vertex_offset + header.vertex_size);
+
+        // Written to a temporary first so that a concurrent reader never maps a partial file. Loaders may write the
+        // cache of the same source at once, so every writer gets its own temporary
+        static std::atomic<std::uint64_t> temporary_counter{0};
+        auto temporary = path;
+        temporary += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "." +
+                     std::to_string(temporary_counter++) + ".tmp";
+        {
+            std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+            if (!stream) {
+                std::clog << "Could not write mesh cache " << path.string() << '\n';
+                return false;
+            }
+
+            static constexpr char padding[mesh_cache_alignment]{};
+            auto pad_to = [&stream](std::uint64_t offset) {
+                const auto position = static_cast<std::uint64_t>(stream.tellp());
+                stream.write(padding, static_cast<std::streamsize>(offset - position));
+            };
+
+            stream.write(reinterpret_cast<const char *>(&header), sizeof(mesh_header));
+            stream.write(key.data(), static_cast<std::streamsize>(key.size()));
+            pad_to(header.vertex_offset);
+            stream.write(static_cast<const char *>(vertex_data), static_cast<std::streamsize>(header.vertex_size));
+            pad_to(header.index_offset);
+            stream.write(static_cast<const char *>(index_data), static_cast<std::streamsize>(header.index_size));
+
+            if (!stream) {
+                std::clog << "Could not write mesh cache " << path.string() << '\n';
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::clog << "Could not write mesh cache " << path.string() << ": " << error.message() << '\n';
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        std::clog << "Wrote mesh cache " << path.string() << '\n';
+        return true;
+    }
+}
+
+#endif //WGA_GEOMETRY_MESH_CACHE_HPP
@@ -0,0 +1,311 @@
+#ifndef WGA_GEOMETRY_OBJ_HPP
+#define WGA_GEOMETRY_OBJ_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <wga/mapped_file.hpp>
+#include <wga/geometry/text.hpp>
+
+namespace wga::geometry {
+    // Zero-based indices into obj_data, -1 when the corner has no such attribute
+    struct obj_index {
+        int vertex_index;
+        int normal_index;
+        int texcoord_index;
+    };
+
+    // Mirrors the layout of tinyobj::attrib_t, with every face triangulated into indices
+    struct obj_data {
+        std::vector<float> vertices;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        std::vector<float> colors;
+        std::vector<obj_index> indices;
+    };
+
+    struct obj_chunk {
+        const char *first{nullptr};
+        const char *last{nullptr};
+
+        std::size_t line_offset{0};
+        std::size_t line_count{0};
+        std::size_t vertex_offset{0};
+        std::size_t vertex_count{0};
+        std::size_t normal_offset{0};
+        std::size_t normal_count{0};
+        std::size_t texcoord_offset{0};
+        std::size_t texcoord_count{0};
+
+        std::vector<obj_index> indices;
+        std::size_t error_line{0};
+    };
+
+    enum class obj_statement {
+        other,
+        vertex,
+        normal,
+        texcoord,
+        face,
+    };
+
+    auto get_obj_statement(const char *&first, const char *last) noexcept {
+        first = text::skip_blanks(first, last);
+        const auto length = last - first;
+
+        if (length >= 2 && first[0] == 'v' && text::is_blank(first[1])) {
+            first += 1;
+            return obj_statement::vertex;
+        }
+        if (length >= 3 && first[0] == 'v' && first[1] == 'n' && text::is_blank(first[2])) {
+            first += 2;
+            return obj_statement::normal;
+        }
+        if (length >= 3 && first[0] == 'v' && first[1] == 't' && text::is_blank(first[2])) {
+            first += 2;
+            return obj_statement::texcoord;
+        }
+        if (length >= 2 && first[0] == 'f' && text::is_blank(first[1])) {
+            first += 1;
+            return obj_statement::face;
+        }
+        return obj_statement::other;
+    }
+
+    // First pass, counts lines and attributes so the shared arrays can be sized before parsing
+    void count_obj_chunk(obj_chunk &chunk) {
+        for (const char *line = chunk.first; line < chunk.last;) {
+            const char *end = text::line_end(line, chunk.last);
+            const char *cursor = line;
+
+            switch (get_obj_statement(cursor, end)) {
+                case obj_statement::vertex:
+                    ++chunk.vertex_count;
+                    break;
+                case obj_statement::normal:
+                    ++chunk.normal_count;
+                    break;
+                case obj_statement::texcoord:
+                    ++chunk.texcoord_count;
+                    break;
+                default:
+                    break;
+            }
+
+            ++chunk.line_count;
+            line = end + 1;
+        }
+    }
+
+    // Resolves a one-based (or negative, relative) OBJ index against the number of elements seen so far
+    bool resolve_obj_index(long long index, std::size_t seen, int &resolved) noexcept {
+        if (index > 0 && static_cast<std::size_t>(index) <= seen) {
+            resolved = static_cast<int>(index - 1);
+            return true;
+        }
+        if (index < 0 && static_cast<std::size_t>(-index) <= seen) {
+            resolved = static_cast<int>(static_cast<long long>(seen) + index);
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_obj_corner(const char *&cursor, const char *last, const obj_chunk &chunk,
+                          std::size_t vertices, std::size_t normals, std::size_t texcoords, obj_index &corner) {
+        corner = {-1, -1, -1};
+
+        long long index = 0;
+        if (!text::parse_number(cursor, last, index) ||
+            !resolve_obj_index(index, chunk.vertex_offset + vertices, corner.vertex_index)) {
+            return false;
+        }
+
+        if (cursor == last || *cursor != '/') {
+            return true;
+        }
+        ++cursor;
+
+        if (cursor != last && *cursor != '/') {
+            if (!text::parse_number(cursor, last, index) ||
+                !resolve_obj_index(index, chunk.texcoord_offset + texcoords, corner.texcoord_index)) {
+                return false;
+            }
+        }
+
+        if (cursor == last || *cursor != '/') {
+            return true;
+        }
+        ++cursor;
+
+        return text::parse_number(cursor, last, index) &&
+               resolve_obj_index(index, chunk.normal_offset + normals, corner.normal_index);
+    }
+
+    // Second pass, writes attributes straight into the shared arrays and collects the chunk's triangles
+    void parse_obj_chunk(obj_chunk &chunk, obj_data &data) {
+        std::size_t vertices = 0;
+        std::size_t normals = 0;
+        std::size_t texcoords = 0;
+        std::size_t line_number = chunk.line_offset;
+
+        std::vector<obj_index> polygon;
+        for (const char *line = chunk.first; line < chunk.last; ++line_number) {
+            const char *end = text::line_end(line, chunk.last);
+            const char *cursor = line;
+            bool ok = true;
+
+            switch (get_obj_statement(cursor, end)) {
+                case obj_statement::vertex: {
+                    float values[6]{};
+                    int count = 0;
+                    while (count < 6 && text::parse_number(cursor, end, values[count])) {
+                        ++count;
+                    }
+                    ok = count >= 3;
+
+                    // "v x y z r g b" carries a vertex color, otherwise the color stays white like with tinyobj
+                    const std::size_t offset = 3 * (chunk.vertex_offset + vertices);
+                    std::copy(values, values + 3, &data.vertices[offset]);
+                    if (count == 6) {
+                        std::copy(values + 3, values + 6, &data.colors[offset]);
+                    }
+                    ++vertices;
+                    break;
+                }
+                case obj_statement::normal: {
+                    float *normal = &data.normals[3 * (chunk.normal_offset + normals)];
+                    ok = text::parse_number(cursor, end, normal[0]) &&
+                         text::parse_number(cursor, end, normal[1]) &&
+                         text::parse_number(cursor, end, normal[2]);
+                    ++normals;
+                    break;
+                }
+                case obj_statement::texcoord: {
+                    float *texcoord = &data.texcoords[2 * (chunk.texcoord_offset + texcoords)];
+                    ok = text::parse_number(cursor, end, texcoord[0]);
+                    if (ok && !text::parse_number(cursor, end, texcoord[1])) {
+                        texcoord[1] = 0.0f;
+                    }
+                    ++texcoords;
+                    break;
+                }
+                case obj_statement::face: {
+                    polygon.clear();
+                    obj_index corner{};
+                    while (text::skip_blanks(cursor, end) != end) {
+                        if (!parse_obj_corner(cursor, end, chunk, vertices, normals, texcoords, corner)) {
+                            ok = false;
+                            break;
+                        }
+                        polygon.push_back(corner);
+                    }
+                    ok = ok && polygon.size() >= 3;
+
+                    // Triangle fan, like tinyobj's default triangulation
+                    for (std::size_t i = 2; ok && i < polygon.size(); ++i) {
+                        chunk.indices.push_back(polygon[0]);
+                        chunk.indices.push_back(polygon[i - 1]);
+                        chunk.indices.push_back(polygon[i]);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            if (!ok) {
+                chunk.error_line = line_number + 1;
+                return;
+            }
+
+            line = end + 1;
+        }
+    }
+
+    // Native OBJ reader, the file is memory mapped and parsed in line-aligned chunks on all cores
+    bool parse_obj(const std::filesystem::path &path, obj_data &data) {
+        const wga::mapped_file file(path);
+        const char *first = file.data();
+        const std::size_t size = file.size();
+
+        // Small files are not worth the thread startup cost
+        static constexpr std::size_t min_chunk_size = 1 << 20;
+        const std::size_t thread_count = std::max<std::size_t>(1, std::min<std::size_t>(
+                std::thread::hardware_concurrency(), size / min_chunk_size));
+
+        std::vector<obj_chunk> chunks;
+        chunks.reserve(thread_count);
+        std::size_t begin = 0;
+        for (std::size_t i = 1; i <= thread_count; ++i) {
+            // The last chunk ends at the end of the file, size / thread_count * thread_count can fall short of it
+            const std::size_t end = i == thread_count ? size
+                                                      : text::align_to_line(first, size, size / thread_count * i);
+            if (end > begin || i == thread_count) {
+                auto &chunk = chunks.emplace_back();
+                chunk.first = first + begin;
+                chunk.last = first + std::max(begin, end);
+            }
+            begin = std::max(begin, end);
+        }
+
+        auto run_parallel = [&chunks](auto &&task) {
+            std::vector<std::thread> threads;
+            threads.reserve(chunks.size() - 1);
+            for (std::size_t i = 1; i < chunks.size(); ++i) {
+                threads.emplace_back([&task, &chunk = chunks[i]] { task(chunk); });
+            }
+            task(chunks[0]);
+            for (auto &thread: threads) {
+                thread.join();
+            }
+        };
+
+        run_parallel([](obj_chunk &chunk) { count_obj_chunk(chunk); });
+
+        std::size_t lines = 0;
+        std::size_t vertices = 0;
+        std::size_t normals = 0;
+        std::size_t texcoords = 0;
+        for (auto &chunk: chunks) {
+            chunk.line_offset = lines;
+            chunk.vertex_offset = vertices;
+            chunk.normal_offset = normals;
+            chunk.texcoord_offset = texcoords;
+            lines += chunk.line_count;
+            vertices += chunk.vertex_count;
+            normals += chunk.normal_count;
+            texcoords += chunk.texcoord_count;
+        }
+
+        data.vertices.assign(3 * vertices, 0.0f);
+        data.colors.assign(3 * vertices, 1.0f);
+        data.normals.assign(3 * normals, 0.0f);
+        data.texcoords.assign(2 * texcoords, 0.0f);
+
+        run_parallel([&data](obj_chunk &chunk) { parse_obj_chunk(chunk, data); });
+
+        std::size_t index_count = 0;
+        for (const auto &chunk: chunks) {
+            if (chunk.error_line != 0) {
+                std::cerr << path.string() << ':' << chunk.error_line << ": malformed OBJ statement\n";
+                return false;
+            }
+            index_count += chunk.indices.size();
+        }
+
+        data.indices.clear();
+        data.indices.reserve(index_count);
+        for (const auto &chunk: chunks) {
+            data.indices.insert(data.indices.end(), chunk.indices.begin(), chunk.indices.end());
+        }
+
+        return true;
+    }
+}
+
+#endif //WGA_GEOMETRY_OBJ_HPP
@@ -0,0 +1,146 @@
+#ifndef WGA_GEOMETRY_SYNTHETIC_HPP
+#define WGA_GEOMETRY_SYNTHETIC_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <wga/shader_types.hpp>
+
+// Generated meshes and scenes of a given size, so benchmarks can scale with the amount of data
+namespace wga::geometry {
+    struct synthetic_mesh {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> uvs;
+        std::vector<std::uint32_t> indices;
+    };
+
+    // A unit grid in the xy plane, made of exactly triangle_count triangles
+    auto make_grid_mesh(std::size_t triangle_count) -> wga::geometry::synthetic_mesh {
+        const std::size_t quad_count = (triangle_count + 1) / 2;
+        const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(quad_count))));
+        const std::size_t rows = side == 0 ? 0 : (quad_count + side - 1) / side;
+
+        wga::geometry::synthetic_mesh mesh;
+        mesh.positions.reserve((side + 1) * (rows + 1));
+        mesh.uvs.reserve((side + 1) * (rows + 1));
+        for (std::size_t y = 0; y <= rows; ++y) {
+            for (std::size_t x = 0; x <= side; ++x) {
+                const glm::vec2 uv{static_cast<float>(x) / static_cast<float>(side),
+                                   static_cast<float>(y) / static_cast<float>(std::max<std::size_t>(rows, 1))};
+                mesh.positions.emplace_back(uv.x - 0.5f, uv.y - 0.5f, 0.0f);
+                mesh.uvs.push_back(uv);
+            }
+        }
+
+        mesh.indices.reserve(3 * triangle_count);
+        for (std::size_t quad = 0; quad < quad_count; ++quad) {
+            const auto x = static_cast<std::uint32_t>(quad % side);
+            const auto y = static_cast<std::uint32_t>(quad / side);
+            const auto stride = static_cast<std::uint32_t>(side + 1);
+            const std::uint32_t corner = y * stride + x;
+
+            mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + stride + 1});
+            if (mesh.indices.size() < 3 * triangle_count) {
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + stride + 1, corner + stride});
+            }
+        }
+        return mesh;
+    }
+
+    auto make_vertex_attributes(const wga::geometry::synthetic_mesh &mesh)
+    -> std::vector<wga::shader_type::vertex_attributes> {
+        std::vector<wga::shader_type::vertex_attributes> vertex_data(mesh.positions.size());
+        for (std::size_t i = 0; i < vertex_data.size(); ++i) {
+            vertex_data[i] = {mesh.positions[i], {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f, 1.0f}, mesh.uvs[i]};
+        }
+        return vertex_data;
+    }
+
+    // Interleaved x, y, [z], r, g, b floats as loaded by wga::geometry::load
+    auto make_point_data(const wga::geometry::synthetic_mesh &mesh, int dimensions) -> std::vector<float> {
+        std::vector<float> point_data;
+        point_data.reserve(mesh.positions.size() * static_cast<std::size_t>(dimensions + 3));
+        for (std::size_t i = 0; i < mesh.positions.size(); ++i) {
+            for (int axis = 0; axis < dimensions; ++axis) {
+                point_data.push_back(axis < 3 ? mesh.positions[i][axis] : 0.0f);
+            }
+            point_data.insert(point_data.end(), {mesh.uvs[i].x, mesh.uvs[i].y, 1.0f});
+        }
+        return point_data;
+    }
+
+    bool write_obj(const std::filesystem::path &path, const wga::geometry::synthetic_mesh &mesh) {
+        std::ofstream stream(path);
+        if (!stream) {
+            std::cerr << "Could not write " << path.string() << '\n';
+            return false;
+        }
+
+        stream << "# " << mesh.indices.size() / 3 << " triangles\n";
+        for (const auto &position: mesh.positions) {
+            stream << "v " << position.x << ' ' << position.y << ' ' << position.z << '\n';
+        }
+        for (const auto &uv: mesh.uvs) {
+            stream << "vt " << uv.x << ' ' << uv.y << '\n';
+        }
+        stream << "vn 0 0 1\n";
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            stream << 'f';
+            for (std::size_t corner = 0; corner < 3; ++corner) {
+                const auto index = mesh.indices[i + corner] + 1;
+                stream << ' ' << index << '/' << index << "/1";
+            }
+            stream << '\n';
+        }
+        return static_cast<bool>(stream);
+    }
+
+    // [points]/[indices] text format, dimensions is 2 or 3
+    bool write_points(const std::filesystem::path &path, const wga::geometry::synthetic_mesh &mesh, int dimensions) {
+        std::ofstream stream(path);
+        if (!stream) {
+            std::cerr << "Could not write " << path.string() << '\n';
+            return false;
+        }
+
+        stream << "[points]\n";
+        for (std::size_t i = 0; i < mesh.positions.size(); ++i) {
+            for (int axis = 0; axis < dimensions; ++axis) {
+                stream << mesh.positions[i][axis] << ' ';
+            }
+            stream << mesh.uvs[i].x << ' ' << mesh.uvs[i].y << " 1\n";
+        }
+
+        stream << "\n[indices]\n";
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            stream << mesh.indices[i] << ' ' << mesh.indices[i + 1] << ' ' << mesh.indices[i + 2] << '\n';
+        }
+        return static_cast<bool>(stream);
+    }
+
+    // object_count model matrices on a square grid filling [-1, 1]
+    auto make_object_grid(std::size_t object_count) -> std::vector<glm::mat4x4> {
+        const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(object_count))));
+        const float spacing = 2.0f / static_cast<float>(std::max<std::size_t>(side, 1));
+
+        std::vector<glm::mat4x4> transforms;
+        transforms.reserve(object_count);
+        for (std::size_t i = 0; i < object_count; ++i) {
+            glm::mat4x4 transform(0.5f * spacing);
+            transform[3] = glm::vec4(-1.0f + spacing * (static_cast<float>(i % side) + 0.5f),
+                                     -1.0f + spacing * (static_cast<float>(i / side) + 0.5f), 0.0f, 1.0f);
+            transforms.push_back(transform);
+        }
+        return transforms;
+    }
+}
+
+#endif //WGA_GEOMETRY_SYNTHETIC_HPP
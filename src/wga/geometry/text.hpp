@@ -0,0 +1,56 @@
+#ifndef WGA_GEOMETRY_TEXT_HPP
+#define WGA_GEOMETRY_TEXT_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+
+// Small helpers for scanning text geometry formats in place, without copying lines into strings
+namespace wga::geometry::text {
+    bool is_blank(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    auto skip_blanks(const char *first, const char *last) noexcept -> const char * {
+        while (first != last && is_blank(*first)) {
+            ++first;
+        }
+        return first;
+    }
+
+    // Returns the end of the line starting at first, excluding the '\n'
+    auto line_end(const char *first, const char *last) noexcept -> const char * {
+        const auto *newline = static_cast<const char *>(
+                std::memchr(first, '\n', static_cast<std::size_t>(last - first)));
+        return newline ? newline : last;
+    }
+
+    // Advances first past the next number, std::from_chars does not accept a leading '+'
+    template<typename T>
+    bool parse_number(const char *&first, const char *last, T &value) noexcept {
+        first = skip_blanks(first, last);
+        if (first != last && *first == '+') {
+            ++first;
+        }
+
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc{}) {
+            return false;
+        }
+
+        first = ptr;
+        return true;
+    }
+
+    // Moves the chunk boundary at position forward to the start of the next line
+    auto align_to_line(const char *data, std::size_t size, std::size_t position) noexcept -> std::size_t {
+        if (position == 0 || position >= size) {
+            return position >= size ? size : 0;
+        }
+        const auto *end = line_end(data + position - 1, data + size);
+        return end == data + size ? size : static_cast<std::size_t>(end - data) + 1;
+    }
+}
+
+#endif //WGA_GEOMETRY_TEXT_HPP
@@ -0,0 +1,40 @@
+#ifndef WGA_IMAGE_HPP
+#define WGA_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// CPU side images, decoded from disk or generated, see wga/image_processing.hpp and wga/texture.hpp
+namespace wga {
+    // Tightly packed RGBA8 pixels
+    struct image {
+        std::uint32_t width{0};
+        std::uint32_t height{0};
+        std::vector<std::uint8_t> pixels;
+    };
+
+    auto load_image(const std::filesystem::path &path) -> wga::image {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        auto *data = stbi_load(path.string().c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            std::cerr << "Could not load image " << path.string() << ": " << stbi_failure_reason() << '\n';
+            throw std::runtime_error("Could not load image: " + path.string());
+        }
+
+        wga::image image{static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), {}};
+        image.pixels.assign(data, data + std::size_t{image.width} * image.height * 4);
+        stbi_image_free(data);
+        return image;
+    }
+}
+
+#endif //WGA_IMAGE_HPP
@@ -0,0 +1,448 @@
+#ifndef WGA_IMAGE_PROCESSING_HPP
+#define WGA_IMAGE_PROCESSING_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WGA_IMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define WGA_IMAGE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#include <wga/image.hpp>
+#include <wga/thread_pool.hpp>
+
+// CPU image kernels for procedural textures and offline baking: images are processed in bands of rows, one task per
+// band on a thread pool, with SSE kernels where available and scalar loops otherwise
+namespace wga {
+    // Rows per task are chosen so a band of source and destination stays in L2, about 64 rows of an 8K RGBA8 image
+    static constexpr std::size_t image_band_bytes = 256 * 1024;
+
+    // RGBA floats in linear space
+    struct linear_image {
+        std::uint32_t width{0};
+        std::uint32_t height{0};
+        std::vector<float> pixels;
+    };
+
+    enum class mip_filter {
+        box,    // 2x2 average
+        kaiser, // 6 tap windowed sinc, sharper minification
+    };
+
+    // Calls rows(first, last) for bands of [0, height) on pool and waits for all of them, serially without a pool.
+    // Must not be called from a task of the same pool
+    template<typename F>
+    void parallel_rows(wga::thread_pool *pool, std::uint32_t height, std::size_t row_bytes, F &&rows) {
+        const auto band = static_cast<std::uint32_t>(
+                std::max<std::size_t>(1, wga::image_band_bytes / std::max<std::size_t>(row_bytes, 1)));
+        if (!pool || height <= band) {
+            rows(std::uint32_t{0}, height);
+            return;
+        }
+
+        std::vector<std::future<void>> bands;
+        for (std::uint32_t first = 0; first < height; first += band) {
+            const auto last = std::min(height, first + band);
+            bands.push_back(pool->submit([&rows, first, last] { rows(first, last); }));
+        }
+        // Every band has to finish before an exception leaves this frame, they refer to rows
+        for (auto &future: bands) {
+            future.wait();
+        }
+        for (auto &future: bands) {
+            future.get();
+        }
+    }
+
+    // pixel(x, y) returns RGBA8 packed with red in the lowest byte, it is called row by row
+    template<typename F>
+    auto generate_image(wga::thread_pool *pool, std::uint32_t width, std::uint32_t height, F &&pixel) -> wga::image {
+        wga::image image{width, height, std::vector<std::uint8_t>(std::size_t{4} * width * height)};
+        wga::parallel_rows(pool, height, std::size_t{4} * width, [&](std::uint32_t first, std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                auto *row = image.pixels.data() + std::size_t{4} * width * y;
+                for (std::uint32_t x = 0; x < width; ++x) {
+                    const std::uint32_t value = pixel(x, y);
+                    row[4 * x + 0] = static_cast<std::uint8_t>(value);
+                    row[4 * x + 1] = static_cast<std::uint8_t>(value >> 8);
+                    row[4 * x + 2] = static_cast<std::uint8_t>(value >> 16);
+                    row[4 * x + 3] = static_cast<std::uint8_t>(value >> 24);
+                }
+            }
+        });
+        return image;
+    }
+
+    // Only two distinct rows exist, they are built once and copied
+    auto make_checkerboard(wga::thread_pool *pool, std::uint32_t width, std::uint32_t height, std::uint32_t cell_size,
+                           std::uint32_t color_0 = 0xffffffff, std::uint32_t color_1 = 0xff000000) -> wga::image {
+        cell_size = std::max(cell_size, 1u);
+        std::array<std::vector<std::uint8_t>, 2> rows;
+        for (std::size_t parity = 0; parity < rows.size(); ++parity) {
+            rows[parity].resize(std::size_t{4} * width);
+            for (std::uint32_t x = 0; x < width; ++x) {
+                const auto value = (x / cell_size + parity) % 2 == 0 ? color_0 : color_1;
+                for (std::uint32_t channel = 0; channel < 4; ++channel) {
+                    rows[parity][4 * x + channel] = static_cast<std::uint8_t>(value >> (8 * channel));
+                }
+            }
+        }
+
+        wga::image image{width, height, std::vector<std::uint8_t>(std::size_t{4} * width * height)};
+        wga::parallel_rows(pool, height, std::size_t{4} * width, [&](std::uint32_t first, std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                std::memcpy(image.pixels.data() + std::size_t{4} * width * y, rows[(y / cell_size) % 2].data(),
+                            rows[0].size());
+            }
+        });
+        return image;
+    }
+
+    void convert_rgb_to_rgba_row(const std::uint8_t *source, std::uint8_t *destination, std::uint32_t count) {
+        std::uint32_t x = 0;
+#ifdef WGA_IMAGE_SSSE3
+        // 4 pixels per iteration from a 16 byte load, so the last 2 pixels are left to the scalar loop
+        const auto shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const auto alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+        for (; x + 6 <= count; x += 4) {
+            const auto rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 3 * x));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + 4 * x),
+                             _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+        }
+#endif
+        for (; x < count; ++x) {
+            destination[4 * x + 0] = source[3 * x + 0];
+            destination[4 * x + 1] = source[3 * x + 1];
+            destination[4 * x + 2] = source[3 * x + 2];
+            destination[4 * x + 3] = 255;
+        }
+    }
+
+    // Tightly packed RGB8 to RGBA8 with opaque alpha
+    auto convert_rgb_to_rgba(wga::thread_pool *pool, const std::uint8_t *rgb, std::uint32_t width,
+                             std::uint32_t height) -> wga::image {
+        wga::image image{width, height, std::vector<std::uint8_t>(std::size_t{4} * width * height)};
+        wga::parallel_rows(pool, height, std::size_t{7} * width, [&](std::uint32_t first, std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                wga::convert_rgb_to_rgba_row(rgb + std::size_t{3} * width * y,
+                                             image.pixels.data() + std::size_t{4} * width * y, width);
+            }
+        });
+        return image;
+    }
+
+    auto srgb_to_linear(float value) noexcept -> float {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    auto linear_to_srgb(float value) noexcept -> float {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Every 8 bit sRGB value decoded once
+    auto get_srgb_to_linear_table() -> const std::array<float, 256> & {
+        static const auto table = [] {
+            std::array<float, 256> values{};
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                values[i] = wga::srgb_to_linear(static_cast<float>(i) / 255.0f);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    // Linear values quantized to 12 bits, fine enough that neighbouring entries differ by at most one 8 bit step
+    static constexpr std::size_t linear_to_srgb_table_size = 4096;
+
+    auto get_linear_to_srgb_table() -> const std::array<std::uint8_t, wga::linear_to_srgb_table_size> & {
+        static const auto table = [] {
+            std::array<std::uint8_t, wga::linear_to_srgb_table_size> values{};
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                const auto linear = static_cast<float>(i) / static_cast<float>(values.size() - 1);
+                values[i] = static_cast<std::uint8_t>(wga::linear_to_srgb(linear) * 255.0f + 0.5f);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    // Color channels are decoded from sRGB, alpha is already linear
+    auto to_linear(wga::thread_pool *pool, const wga::image &image) -> wga::linear_image {
+        const auto &table = wga::get_srgb_to_linear_table();
+        wga::linear_image result{image.width, image.height,
+                                 std::vector<float>(std::size_t{4} * image.width * image.height)};
+        wga::parallel_rows(pool, image.height, std::size_t{20} * image.width, [&](std::uint32_t first,
+                                                                               std::uint32_t last) {
+            const auto begin = std::size_t{4} * image.width * first;
+            const auto end = std::size_t{4} * image.width * last;
+            for (auto i = begin; i < end; i += 4) {
+                result.pixels[i + 0] = table[image.pixels[i + 0]];
+                result.pixels[i + 1] = table[image.pixels[i + 1]];
+                result.pixels[i + 2] = table[image.pixels[i + 2]];
+                result.pixels[i + 3] = static_cast<float>(image.pixels[i + 3]) * (1.0f / 255.0f);
+            }
+        });
+        return result;
+    }
+
+    // Values are clamped to [0, 1], filters with negative lobes overshoot at edges
+    auto to_srgb(wga::thread_pool *pool, const wga::linear_image &image) -> wga::image {
+        const auto &table = wga::get_linear_to_srgb_table();
+        constexpr auto table_scale = static_cast<float>(wga::linear_to_srgb_table_size - 1);
+        wga::image result{image.width, image.height,
+                          std::vector<std::uint8_t>(std::size_t{4} * image.width * image.height)};
+        wga::parallel_rows(pool, image.height, std::size_t{20} * image.width, [&](std::uint32_t first,
+                                                                               std::uint32_t last) {
+            const auto begin = std::size_t{4} * image.width * first;
+            const auto end = std::size_t{4} * image.width * last;
+            for (auto i = begin; i < end; i += 4) {
+                for (std::size_t channel = 0; channel < 3; ++channel) {
+                    const auto value = std::clamp(image.pixels[i + channel], 0.0f, 1.0f);
+                    result.pixels[i + channel] = table[static_cast<std::size_t>(value * table_scale + 0.5f)];
+                }
+                const auto alpha = std::clamp(image.pixels[i + 3], 0.0f, 1.0f);
+                result.pixels[i + 3] = static_cast<std::uint8_t>(alpha * 255.0f + 0.5f);
+            }
+        });
+        return result;
+    }
+
+    // c * a / 255 rounded, exact for all 8 bit inputs
+    void premultiply_alpha_row(std::uint8_t *row, std::uint32_t count) {
+        std::uint32_t x = 0;
+#ifdef WGA_IMAGE_SSE2
+        // Alpha is multiplied by 255 so it passes through the same rounding unchanged
+        const auto color_mask = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+        const auto alpha_one = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+        const auto bias = _mm_set1_epi16(128);
+        const auto zero = _mm_setzero_si128();
+        const auto premultiply = [&](__m128i pixels) {
+            auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+                                             _MM_SHUFFLE(3, 3, 3, 3));
+            alpha = _mm_or_si128(_mm_and_si128(alpha, color_mask), alpha_one);
+            const auto product = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), bias);
+            return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+        };
+        for (; x + 4 <= count; x += 4) {
+            auto *pointer = reinterpret_cast<__m128i *>(row + 4 * x);
+            const auto pixels = _mm_loadu_si128(pointer);
+            _mm_storeu_si128(pointer, _mm_packus_epi16(premultiply(_mm_unpacklo_epi8(pixels, zero)),
+                                                       premultiply(_mm_unpackhi_epi8(pixels, zero))));
+        }
+#endif
+        for (; x < count; ++x) {
+            const std::uint32_t alpha = row[4 * x + 3];
+            for (std::uint32_t channel = 0; channel < 3; ++channel) {
+                const auto product = row[4 * x + channel] * alpha + 128;
+                row[4 * x + channel] = static_cast<std::uint8_t>((product + (product >> 8)) >> 8);
+            }
+        }
+    }
+
+    // In place, on the encoded values
+    void premultiply_alpha(wga::thread_pool *pool, wga::image &image) {
+        wga::parallel_rows(pool, image.height, std::size_t{4} * image.width, [&](std::uint32_t first,
+                                                                              std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                wga::premultiply_alpha_row(image.pixels.data() + std::size_t{4} * image.width * y, image.width);
+            }
+        });
+    }
+
+    // In place, premultiplying linear values before downsampling keeps transparent texels from bleeding their color
+    void premultiply_alpha(wga::thread_pool *pool, wga::linear_image &image) {
+        wga::parallel_rows(pool, image.height, std::size_t{16} * image.width, [&](std::uint32_t first,
+                                                                               std::uint32_t last) {
+            auto *pixel = image.pixels.data() + std::size_t{4} * image.width * first;
+            auto *end = image.pixels.data() + std::size_t{4} * image.width * last;
+#ifdef WGA_IMAGE_SSE2
+            const auto color_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+            for (; pixel != end; pixel += 4) {
+                const auto value = _mm_loadu_ps(pixel);
+                const auto product = _mm_mul_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3)));
+                _mm_storeu_ps(pixel, _mm_or_ps(_mm_and_ps(color_mask, product), _mm_andnot_ps(color_mask, value)));
+            }
+#else
+            for (; pixel != end; pixel += 4) {
+                pixel[0] *= pixel[3];
+                pixel[1] *= pixel[3];
+                pixel[2] *= pixel[3];
+            }
+#endif
+        });
+    }
+
+    // Each level halves the previous one, rounding down like GPU mip levels
+    constexpr auto get_mip_size(std::uint32_t size) -> std::uint32_t {
+        return std::max(size / 2, 1u);
+    }
+
+    // Odd sizes drop the last row or column, the same texels the GPU mipmap generator reads
+    auto downsample_box(wga::thread_pool *pool, const wga::linear_image &image) -> wga::linear_image {
+        const auto width = wga::get_mip_size(image.width);
+        const auto height = wga::get_mip_size(image.height);
+        wga::linear_image result{width, height, std::vector<float>(std::size_t{4} * width * height)};
+        wga::parallel_rows(pool, height, std::size_t{48} * width, [&](std::uint32_t first, std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                const auto *row_0 = image.pixels.data() + std::size_t{4} * image.width * std::min(2 * y, image.height - 1);
+                const auto *row_1 = image.pixels.data() +
+                                    std::size_t{4} * image.width * std::min(2 * y + 1, image.height - 1);
+                auto *destination = result.pixels.data() + std::size_t{4} * width * y;
+                for (std::uint32_t x = 0; x < width; ++x) {
+                    const auto x_0 = std::size_t{4} * std::min(2 * x, image.width - 1);
+                    const auto x_1 = std::size_t{4} * std::min(2 * x + 1, image.width - 1);
+#ifdef WGA_IMAGE_SSE2
+                    const auto sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row_0 + x_0), _mm_loadu_ps(row_0 + x_1)),
+                                                _mm_add_ps(_mm_loadu_ps(row_1 + x_0), _mm_loadu_ps(row_1 + x_1)));
+                    _mm_storeu_ps(destination + 4 * x, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                    for (std::size_t channel = 0; channel < 4; ++channel) {
+                        destination[4 * x + channel] = 0.25f * (row_0[x_0 + channel] + row_0[x_1 + channel] +
+                                                                row_1[x_0 + channel] + row_1[x_1 + channel]);
+                    }
+#endif
+                }
+            }
+        });
+        return result;
+    }
+
+    // Zeroth order modified Bessel function of the first kind, the series converges quickly for the betas used here
+    auto bessel_i0(double x) -> double {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr std::size_t kaiser_tap_count = 6;
+
+    // Weights for source texels 2x - 2 .. 2x + 3 of output texel x, a sinc for half the sample rate windowed by a
+    // Kaiser window, normalized so flat areas keep their value
+    auto get_kaiser_weights(double beta = 4.0) -> std::array<float, wga::kaiser_tap_count> {
+        constexpr double pi = 3.14159265358979323846;
+        constexpr double half_width = wga::kaiser_tap_count / 2.0;
+        std::array<double, wga::kaiser_tap_count> weights{};
+        double total = 0.0;
+        for (std::size_t i = 0; i < weights.size(); ++i) {
+            // Distance from the output texel center, which lies between source texels 2x and 2x + 1
+            const auto distance = static_cast<double>(i) - half_width + 0.5;
+            const auto sinc = std::sin(pi * distance / 2.0) / (pi * distance / 2.0);
+            const auto t = distance / half_width;
+            weights[i] = sinc * wga::bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - t * t))) / wga::bessel_i0(beta);
+            total += weights[i];
+        }
+
+        std::array<float, wga::kaiser_tap_count> normalized{};
+        for (std::size_t i = 0; i < weights.size(); ++i) {
+            normalized[i] = static_cast<float>(weights[i] / total);
+        }
+        return normalized;
+    }
+
+    // Adds weight * source to destination for count RGBA pixels
+    void accumulate_row(float *destination, const float *source, float weight, std::uint32_t count) {
+#ifdef WGA_IMAGE_SSE2
+        const auto factor = _mm_set1_ps(weight);
+        for (std::uint32_t x = 0; x < count; ++x) {
+            _mm_storeu_ps(destination + 4 * x, _mm_add_ps(_mm_loadu_ps(destination + 4 * x),
+                                                          _mm_mul_ps(factor, _mm_loadu_ps(source + 4 * x))));
+        }
+#else
+        for (std::size_t i = 0; i < std::size_t{4} * count; ++i) {
+            destination[i] += weight * source[i];
+        }
+#endif
+    }
+
+    // Separable: a horizontal pass into a half width image, then a vertical pass over whole rows. Texels outside the
+    // image are clamped to the edge
+    auto downsample_kaiser(wga::thread_pool *pool, const wga::linear_image &image) -> wga::linear_image {
+        static const auto weights = wga::get_kaiser_weights();
+        constexpr auto first_tap = -static_cast<std::int64_t>(wga::kaiser_tap_count / 2) + 1;
+        const auto clamp_index = [](std::int64_t index, std::uint32_t size) {
+            return static_cast<std::size_t>(std::clamp<std::int64_t>(index, 0, std::int64_t{size} - 1));
+        };
+
+        const auto width = wga::get_mip_size(image.width);
+        const auto height = wga::get_mip_size(image.height);
+        wga::linear_image horizontal{width, image.height, std::vector<float>(std::size_t{4} * width * image.height)};
+        wga::parallel_rows(pool, image.height, std::size_t{48} * width, [&](std::uint32_t first, std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                const auto *source = image.pixels.data() + std::size_t{4} * image.width * y;
+                auto *destination = horizontal.pixels.data() + std::size_t{4} * width * y;
+                for (std::uint32_t x = 0; x < width; ++x) {
+                    // Only the texels near the left and right edge need clamping
+                    const auto base = std::int64_t{2} * x + first_tap;
+                    const bool inside = base >= 0 && base + std::int64_t{wga::kaiser_tap_count} <= image.width;
+#ifdef WGA_IMAGE_SSE2
+                    auto sum = _mm_setzero_ps();
+                    for (std::size_t tap = 0; tap < wga::kaiser_tap_count; ++tap) {
+                        const auto index = inside ? static_cast<std::size_t>(base) + tap
+                                                  : clamp_index(base + static_cast<std::int64_t>(tap), image.width);
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]),
+                                                         _mm_loadu_ps(source + 4 * index)));
+                    }
+                    _mm_storeu_ps(destination + 4 * x, sum);
+#else
+                    for (std::size_t tap = 0; tap < wga::kaiser_tap_count; ++tap) {
+                        const auto index = inside ? static_cast<std::size_t>(base) + tap
+                                                  : clamp_index(base + static_cast<std::int64_t>(tap), image.width);
+                        wga::accumulate_row(destination + 4 * x, source + 4 * index, weights[tap], 1);
+                    }
+#endif
+                }
+            }
+        });
+
+        wga::linear_image result{width, height, std::vector<float>(std::size_t{4} * width * height)};
+        wga::parallel_rows(pool, height, std::size_t{112} * width, [&](std::uint32_t first, std::uint32_t last) {
+            for (auto y = first; y < last; ++y) {
+                auto *destination = result.pixels.data() + std::size_t{4} * width * y;
+                for (std::size_t tap = 0; tap < wga::kaiser_tap_count; ++tap) {
+                    const auto row = clamp_index(std::int64_t{2} * y + first_tap + static_cast<std::int64_t>(tap),
+                                                 image.height);
+                    wga::accumulate_row(destination, horizontal.pixels.data() + std::size_t{4} * width * row,
+                                        weights[tap], width);
+                }
+            }
+        });
+        return result;
+    }
+
+    auto downsample(wga::thread_pool *pool, const wga::linear_image &image, wga::mip_filter filter)
+    -> wga::linear_image {
+        return filter == wga::mip_filter::kaiser ? wga::downsample_kaiser(pool, image)
+                                                 : wga::downsample_box(pool, image);
+    }
+
+    // Level 0 is the image itself, levels are filtered in linear space from the previous one down to 1x1
+    auto generate_mip_chain(wga::thread_pool *pool, const wga::image &image,
+                            wga::mip_filter filter = wga::mip_filter::box) -> std::vector<wga::image> {
+        std::vector<wga::image> levels;
+        levels.push_back(image);
+        auto level = wga::to_linear(pool, image);
+        while (level.width > 1 || level.height > 1) {
+            level = wga::downsample(pool, level, filter);
+            levels.push_back(wga::to_srgb(pool, level));
+        }
+        return levels;
+    }
+}
+
+#endif //WGA_IMAGE_PROCESSING_HPP
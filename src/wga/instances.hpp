@@ -0,0 +1,65 @@
+#ifndef WGA_INSTANCES_HPP
+#define WGA_INSTANCES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+#include <wga/shader_types.hpp>
+#include <wga/staging_belt.hpp>
+
+// Per instance vertex stream, bound to slot 1 of pipelines created with instanced = true
+namespace wga {
+    // Largest instance buffer get_device reserves room for
+    static constexpr std::uint32_t max_instance_count = 1 << 17;
+
+    struct instance_buffer {
+        wga::object<wgpu::Buffer, true> buffer;
+        std::uint32_t capacity;
+        std::uint32_t count;
+    };
+
+    auto create_instance_buffer(wga::object<wgpu::Device> &device, std::uint32_t capacity) -> wga::instance_buffer {
+        if (capacity > max_instance_count) {
+            std::cerr << "Instance buffer capacity " << capacity << " exceeds " << max_instance_count << '\n';
+            throw std::runtime_error("Instance buffer too large");
+        }
+        return wga::instance_buffer{
+                wga::create_buffer(device, std::uint64_t{capacity} * sizeof(wga::shader_type::instance_attributes),
+                                   wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex),
+                capacity,
+                0};
+    }
+
+    // Stages instances [first, first + count) as a single copy, recorded by staging_belt.encode
+    void update_instances(wga::object<wgpu::Device> &device, wga::staging_belt &staging_belt,
+                          wga::instance_buffer &instances,
+                          const wga::shader_type::instance_attributes *data, std::uint32_t count,
+                          std::uint32_t first = 0) {
+        if (first + count > instances.capacity) {
+            std::cerr << "Instance update [" << first << ", " << first + count << ") exceeds capacity "
+                      << instances.capacity << '\n';
+            throw std::runtime_error("Instance update out of range");
+        }
+        if (count > 0) {
+            staging_belt.write_buffer(device, instances.buffer.get(), first * sizeof(wga::shader_type::instance_attributes),
+                                      data, count * sizeof(wga::shader_type::instance_attributes));
+        }
+        instances.count = std::max(instances.count, first + count);
+    }
+
+    // Replaces all instances, the instance count becomes data.size()
+    void update_instances(wga::object<wgpu::Device> &device, wga::staging_belt &staging_belt,
+                          wga::instance_buffer &instances, const std::vector<wga::shader_type::instance_attributes> &data) {
+        instances.count = 0;
+        wga::update_instances(device, staging_belt, instances, data.data(), static_cast<std::uint32_t>(data.size()));
+    }
+}
+
+#endif //WGA_INSTANCES_HPP
@@ -0,0 +1,137 @@
+#ifndef WGA_MAPPED_FILE_HPP
+#define WGA_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wga {
+    // Read-only view of a whole file mapped into memory
+    struct mapped_file {
+        explicit mapped_file(const std::filesystem::path &path) {
+            auto fail = [&path](const char *what) {
+                const std::string message = std::string(what) + ": " + path.string();
+                std::cerr << message << '\n';
+                throw std::runtime_error(message);
+            };
+
+#ifdef _WIN32
+            file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                fail("Could not open file");
+            }
+
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size)) {
+                CloseHandle(file);
+                fail("Could not query file size");
+            }
+            length = static_cast<std::size_t>(file_size.QuadPart);
+
+            if (length > 0) {
+                mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!mapping) {
+                    CloseHandle(file);
+                    fail("Could not map file");
+                }
+                bytes = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (!bytes) {
+                    CloseHandle(mapping);
+                    CloseHandle(file);
+                    fail("Could not map file");
+                }
+            }
+#else
+            descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) {
+                fail("Could not open file");
+            }
+
+            struct stat status{};
+            if (::fstat(descriptor, &status) != 0) {
+                ::close(descriptor);
+                fail("Could not query file size");
+            }
+            length = static_cast<std::size_t>(status.st_size);
+
+            if (length > 0) {
+                void *address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if (address == MAP_FAILED) {
+                    ::close(descriptor);
+                    fail("Could not map file");
+                }
+                ::madvise(address, length, MADV_SEQUENTIAL);
+                bytes = static_cast<const char *>(address);
+            }
+#endif
+        }
+
+        mapped_file(const mapped_file &) = delete;
+
+        auto operator=(const mapped_file &) -> mapped_file & = delete;
+
+        mapped_file(mapped_file &&) = delete;
+
+        auto operator=(mapped_file &&) -> mapped_file & = delete;
+
+        ~mapped_file() {
+#ifdef _WIN32
+            if (bytes) {
+                UnmapViewOfFile(bytes);
+            }
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+#else
+            if (bytes) {
+                ::munmap(const_cast<char *>(bytes), length);
+            }
+            ::close(descriptor);
+#endif
+        }
+
+        [[nodiscard]] auto data() const noexcept -> const char * {
+            return bytes;
+        }
+
+        [[nodiscard]] auto size() const noexcept -> std::size_t {
+            return length;
+        }
+
+        [[nodiscard]] auto view() const noexcept -> std::string_view {
+            return {bytes, length};
+        }
+
+    private:
+        const char *bytes{nullptr};
+        std::size_t length{0};
+#ifdef _WIN32
+        HANDLE file{INVALID_HANDLE_VALUE};
+        HANDLE mapping{nullptr};
+#else
+        int descriptor{-1};
+#endif
+    };
+}
+
+#endif //WGA_MAPPED_FILE_HPP
@@ -0,0 +1,113 @@
+#ifndef WGA_MATERIAL_TEXTURES_HPP
+#define WGA_MATERIAL_TEXTURES_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/block_compression.hpp>
+#include <wga/image.hpp>
+#include <wga/setup.hpp>
+#include <wga/texture.hpp>
+#include <wga/thread_pool.hpp>
+
+// Material textures of one size and format packed as layers of a single texture array. Every material binds the
+// same view, so draws of different materials share one bind group and only differ in uniforms::texture_layer or
+// instance_attributes::texture_layer
+namespace wga {
+    struct material_textures {
+        wga::texture texture; // texture.size.depthOrArrayLayers layers
+        std::optional<wga::block_format> compression; // levels are compressed to this format when added
+        std::unordered_map<std::string, std::uint32_t> layers; // by material name
+
+        [[nodiscard]] auto capacity() const noexcept -> std::uint32_t {
+            return texture.size.depthOrArrayLayers;
+        }
+
+        [[nodiscard]] auto find(const std::string &name) const -> std::optional<std::uint32_t> {
+            const auto it = layers.find(name);
+            return it != layers.end() ? std::optional{it->second} : std::nullopt;
+        }
+    };
+
+    // Room for capacity layers with full mip chains. compression is dropped when the device does not support block
+    // compression or the size is not a multiple of the block dimension, the layers are then stored as RGBA8
+    auto create_material_textures(wga::context &context, std::uint32_t width, std::uint32_t height,
+                                  std::uint32_t capacity,
+                                  std::optional<wga::block_format> compression = std::nullopt)
+    -> wga::material_textures {
+        wgpu::SupportedLimits supported_limits;
+        context.device.get().getLimits(&supported_limits);
+        if (capacity == 0 || capacity > supported_limits.limits.maxTextureArrayLayers) {
+            std::cerr << "Material texture capacity " << capacity << " is outside [1, "
+                      << supported_limits.limits.maxTextureArrayLayers << "]\n";
+            throw std::runtime_error("Material texture capacity out of range");
+        }
+
+        if (!wga::supports_block_compression(context.device) || width % wga::block_dimension != 0 ||
+            height % wga::block_dimension != 0) {
+            compression = std::nullopt;
+        }
+        const auto format = compression ? wga::get_texture_format(*compression) : wga::texture_format;
+        return {wga::create_texture(context.device, width, height, wga::get_mip_level_count(width, height), format,
+                                    capacity),
+                compression, {}};
+    }
+
+    // The layer of name, a new one unless name was added before, in which case its layer is overwritten
+    auto reserve_material_layer(wga::material_textures &textures, const std::string &name) -> std::uint32_t {
+        if (const auto layer = textures.find(name)) {
+            return *layer;
+        }
+        const auto layer = static_cast<std::uint32_t>(textures.layers.size());
+        if (layer >= textures.capacity()) {
+            std::cerr << "Material texture array is full, " << textures.capacity() << " layers, cannot add "
+                      << name << '\n';
+            throw std::runtime_error("Material texture array is full");
+        }
+        textures.layers.emplace(name, layer);
+        return layer;
+    }
+
+    // levels is a full mip chain of the array's size, see wga::generate_mip_chain, compressed on pool when the
+    // array is block compressed. Like other uploads the copies are recorded by the staging belt's next encode
+    auto add_material_texture(wga::context &context, wga::material_textures &textures, const std::string &name,
+                              const std::vector<wga::image> &levels, wga::thread_pool *pool = nullptr)
+    -> std::uint32_t {
+        if (levels.size() != textures.texture.mip_level_count || levels[0].width != textures.texture.size.width ||
+            levels[0].height != textures.texture.size.height) {
+            std::cerr << "Material texture " << name << " has " << levels.size() << " levels of "
+                      << (levels.empty() ? 0 : levels[0].width) << 'x' << (levels.empty() ? 0 : levels[0].height)
+                      << ", the array needs " << textures.texture.mip_level_count << " levels of "
+                      << textures.texture.size.width << 'x' << textures.texture.size.height << '\n';
+            throw std::runtime_error("Material texture does not match the texture array");
+        }
+
+        const auto layer = wga::reserve_material_layer(textures, name);
+        if (textures.compression) {
+            const auto compressed = wga::compress_mip_chain(pool, levels, *textures.compression);
+            for (std::uint32_t level = 0; level < textures.texture.mip_level_count; ++level) {
+                wga::write_texture_level(context, textures.texture, level, compressed[level], layer);
+            }
+        } else {
+            for (std::uint32_t level = 0; level < textures.texture.mip_level_count; ++level) {
+                wga::write_texture_level(context, textures.texture, level, levels[level], layer);
+            }
+        }
+        return layer;
+    }
+
+    // Shared by every material in textures
+    auto create_bind_group(wga::context &context, wga::material_textures &textures,
+                           wga::object<wgpu::Sampler> &sampler) {
+        return wga::create_bind_group(context, textures.texture, sampler);
+    }
+}
+
+#endif //WGA_MATERIAL_TEXTURES_HPP
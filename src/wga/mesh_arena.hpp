@@ -0,0 +1,327 @@
+#ifndef WGA_MESH_ARENA_HPP
+#define WGA_MESH_ARENA_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+#include <wga/range_allocator.hpp>
+#include <wga/staging_belt.hpp>
+
+// Vertices and indices of every mesh sub-allocated from a few large buffers, drawn with baseVertex/firstIndex
+namespace wga {
+    static constexpr std::uint64_t default_mesh_vertex_page_size = 64 << 20;
+    static constexpr std::uint64_t default_mesh_index_page_size = 16 << 20;
+
+    // Index ranges are 4 byte aligned so Uint16 and Uint32 meshes can share a page
+    static constexpr std::uint64_t mesh_index_alignment = 4;
+
+    using mesh_id = std::uint32_t;
+
+    struct mesh_range {
+        std::uint32_t page;
+        wga::range_allocation vertices;
+        wga::range_allocation indices;
+        std::uint32_t vertex_stride;
+        std::uint32_t index_count;
+        wgpu::IndexFormat index_format;
+
+        // Vertex ranges are aligned to the stride, so they start at a whole vertex of the page
+        [[nodiscard]] auto base_vertex() const noexcept -> std::int32_t {
+            return static_cast<std::int32_t>(vertices.offset / vertex_stride);
+        }
+
+        [[nodiscard]] auto first_index() const noexcept -> std::uint32_t {
+            return static_cast<std::uint32_t>(indices.offset / (index_format == wgpu::IndexFormat::Uint16 ? 2 : 4));
+        }
+    };
+
+    struct mesh_arena_page {
+        wga::object<wgpu::Buffer, true> vertex_buffer;
+        wga::object<wgpu::Buffer, true> index_buffer;
+        wga::range_allocator vertices;
+        wga::range_allocator indices;
+    };
+
+    auto create_mesh_arena_page(wga::object<wgpu::Device> &device, std::uint64_t vertex_size, std::uint64_t index_size)
+    -> wga::mesh_arena_page {
+        // CopySrc so defragment can move ranges into a new page
+        return wga::mesh_arena_page{
+                wga::create_buffer(device, vertex_size, wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc |
+                                                        wgpu::BufferUsage::Vertex),
+                wga::create_buffer(device, index_size, wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc |
+                                                       wgpu::BufferUsage::Index),
+                wga::create_range_allocator(vertex_size),
+                wga::create_range_allocator(index_size)};
+    }
+
+    // Meshes are referred to by id, so defragment can move their ranges without touching the models.
+    // A freed range can be reused right away: uploads into it are ordered after earlier submissions on the queue
+    struct mesh_arena {
+        std::uint64_t vertex_page_size;
+        std::uint64_t index_page_size;
+        std::uint64_t max_buffer_size;
+
+        std::vector<wga::mesh_arena_page> pages;
+        std::vector<std::optional<wga::mesh_range>> meshes;
+        std::vector<wga::mesh_id> free_ids;
+
+        // Uploads the vertices and indices through staging_belt, they are in place once its copies are submitted
+        auto allocate(wga::object<wgpu::Device> &device, wga::staging_belt &staging_belt,
+                      const void *vertex_data, std::uint64_t vertex_size, std::uint32_t vertex_stride,
+                      const void *index_data, std::uint64_t index_size, std::uint32_t index_count,
+                      wgpu::IndexFormat index_format) -> wga::mesh_id {
+            const auto id = reserve(device, vertex_size, vertex_stride, index_size, index_count, index_format);
+            write_vertices(device, staging_belt, id, 0, vertex_data, vertex_size);
+            write_indices(device, staging_belt, id, 0, index_data, index_size);
+            return id;
+        }
+
+        // Ranges of a mesh whose data is written later, possibly in parts, see write_vertices and write_indices
+        auto reserve(wga::object<wgpu::Device> &device, std::uint64_t vertex_size, std::uint32_t vertex_stride,
+                     std::uint64_t index_size, std::uint32_t index_count, wgpu::IndexFormat index_format)
+        -> wga::mesh_id {
+            if (vertex_stride == 0 || vertex_stride % 4 != 0) {
+                std::cerr << "Vertex stride " << vertex_stride << " is not a multiple of 4\n";
+                throw std::runtime_error("Invalid vertex stride");
+            }
+            // The staging belt copies whole 4 byte words
+            auto range = allocate_range(device, (vertex_size + 3) / 4 * 4, vertex_stride, (index_size + 3) / 4 * 4);
+            range.index_count = index_count;
+            range.index_format = index_format;
+
+            if (!free_ids.empty()) {
+                const auto id = free_ids.back();
+                free_ids.pop_back();
+                meshes[id] = range;
+                return id;
+            }
+            meshes.emplace_back(range);
+            return static_cast<wga::mesh_id>(meshes.size() - 1);
+        }
+
+        // First fit over the pages, a new page is added when none has room
+        auto allocate_range(wga::object<wgpu::Device> &device, std::uint64_t vertex_size, std::uint32_t vertex_stride,
+                            std::uint64_t index_size) -> wga::mesh_range {
+            for (std::uint32_t page = 0; page < pages.size(); ++page) {
+                if (auto range = try_allocate_range(pages, page, vertex_size, vertex_stride, index_size)) {
+                    return *range;
+                }
+            }
+
+            pages.push_back(create_page(device, vertex_size, vertex_stride, index_size));
+            if (auto range = try_allocate_range(pages, static_cast<std::uint32_t>(pages.size() - 1), vertex_size,
+                                                vertex_stride, index_size)) {
+                return *range;
+            }
+            throw std::runtime_error("Could not allocate a mesh range in a new page");
+        }
+
+        // A page of at least the default size, large enough that the range is certain to fit into it while empty
+        auto create_page(wga::object<wgpu::Device> &device, std::uint64_t vertex_size, std::uint32_t vertex_stride,
+                         std::uint64_t index_size) const -> wga::mesh_arena_page {
+            const auto page_vertex_size = std::max(
+                    vertex_page_size, wga::get_range_allocator_capacity(vertex_size, vertex_stride));
+            const auto page_index_size = std::max(
+                    index_page_size, wga::get_range_allocator_capacity(index_size, wga::mesh_index_alignment));
+            if (page_vertex_size > max_buffer_size || page_index_size > max_buffer_size) {
+                std::cerr << "Mesh of " << vertex_size << " vertex bytes and " << index_size
+                          << " index bytes exceeds the device maxBufferSize of " << max_buffer_size << '\n';
+                throw std::runtime_error("Mesh too large");
+            }
+            return wga::create_mesh_arena_page(device, page_vertex_size, page_index_size);
+        }
+
+        static auto try_allocate_range(std::vector<wga::mesh_arena_page> &target_pages, std::uint32_t page,
+                                       std::uint64_t vertex_size, std::uint32_t vertex_stride,
+                                       std::uint64_t index_size) -> std::optional<wga::mesh_range> {
+            auto vertices = target_pages[page].vertices.allocate(vertex_size, vertex_stride);
+            if (!vertices) {
+                return std::nullopt;
+            }
+            auto indices = target_pages[page].indices.allocate(index_size, wga::mesh_index_alignment);
+            if (!indices) {
+                target_pages[page].vertices.free(*vertices);
+                return std::nullopt;
+            }
+            return wga::mesh_range{page, *vertices, *indices, vertex_stride, 0, wgpu::IndexFormat::Undefined};
+        }
+
+        // offset is relative to the mesh's vertex range and must be a multiple of 4
+        void write_vertices(wga::object<wgpu::Device> &device, wga::staging_belt &staging_belt, wga::mesh_id id,
+                            std::uint64_t offset, const void *data, std::uint64_t size) {
+            const auto &range = get(id);
+            staging_belt.write_buffer(device, pages[range.page].vertex_buffer.get(), range.vertices.offset + offset,
+                                      data, size);
+        }
+
+        void write_indices(wga::object<wgpu::Device> &device, wga::staging_belt &staging_belt, wga::mesh_id id,
+                           std::uint64_t offset, const void *data, std::uint64_t size) {
+            const auto &range = get(id);
+            staging_belt.write_buffer(device, pages[range.page].index_buffer.get(), range.indices.offset + offset,
+                                      data, size);
+        }
+
+        void free(wga::mesh_id id) {
+            if (id >= meshes.size() || !meshes[id]) {
+                return;
+            }
+            auto &page = pages[meshes[id]->page];
+            page.vertices.free(meshes[id]->vertices);
+            page.indices.free(meshes[id]->indices);
+            meshes[id].reset();
+            free_ids.push_back(id);
+        }
+
+        [[nodiscard]] auto get(wga::mesh_id id) const -> const wga::mesh_range & {
+            return *meshes[id];
+        }
+
+        [[nodiscard]] auto get_fragmentation() const noexcept -> double {
+            double fragmentation = 0.0;
+            for (const auto &page: pages) {
+                fragmentation = std::max({fragmentation, page.vertices.get_fragmentation(),
+                                          page.indices.get_fragmentation()});
+            }
+            return fragmentation;
+        }
+
+        // Moves the live ranges into as few new pages as possible and drops the old ones. Ranges are placed largest
+        // first, each into the first new page with room, so sparse pages are merged rather than copied one to one.
+        // Pending staging copies are flushed first, since they still target the old buffers
+        void defragment(wga::object<wgpu::Device> &device, wga::object<wgpu::Queue> &queue,
+                        wga::staging_belt &staging_belt) {
+            staging_belt.flush(device, queue);
+
+            std::vector<wga::mesh_id> ids;
+            for (wga::mesh_id id = 0; id < meshes.size(); ++id) {
+                if (meshes[id]) {
+                    ids.push_back(id);
+                }
+            }
+            std::sort(ids.begin(), ids.end(), [this](wga::mesh_id a, wga::mesh_id b) {
+                return meshes[a]->vertices.size > meshes[b]->vertices.size;
+            });
+
+            // Placed before anything is copied, so the arena is left as it was if a page cannot be created
+            std::vector<wga::mesh_arena_page> packed_pages;
+            std::vector<wga::mesh_range> packed_ranges;
+            packed_ranges.reserve(ids.size());
+            for (auto id: ids) {
+                const auto &range = *meshes[id];
+                std::optional<wga::mesh_range> packed;
+                for (std::uint32_t page = 0; !packed && page < packed_pages.size(); ++page) {
+                    packed = try_allocate_range(packed_pages, page, range.vertices.size, range.vertex_stride,
+                                                range.indices.size);
+                }
+                if (!packed) {
+                    packed_pages.push_back(create_page(device, range.vertices.size, range.vertex_stride,
+                                                       range.indices.size));
+                    packed = try_allocate_range(packed_pages, static_cast<std::uint32_t>(packed_pages.size() - 1),
+                                                range.vertices.size, range.vertex_stride, range.indices.size);
+                }
+                if (!packed) {
+                    throw std::runtime_error("Could not allocate a mesh range in a new page");
+                }
+                packed_ranges.push_back(*packed);
+            }
+
+            wgpu::CommandEncoderDescriptor encoder_desc = {};
+            encoder_desc.label = "Mesh arena defragment encoder";
+            auto encoder = wga::object{device.get().createCommandEncoder(encoder_desc)};
+
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                auto &range = *meshes[ids[i]];
+                const auto &packed = packed_ranges[i];
+                const auto &old_page = pages[range.page];
+                const auto &new_page = packed_pages[packed.page];
+                encoder.get().copyBufferToBuffer(old_page.vertex_buffer.get(), range.vertices.offset,
+                                                 new_page.vertex_buffer.get(), packed.vertices.offset,
+                                                 range.vertices.size);
+                encoder.get().copyBufferToBuffer(old_page.index_buffer.get(), range.indices.offset,
+                                                 new_page.index_buffer.get(), packed.indices.offset,
+                                                 range.indices.size);
+                range.page = packed.page;
+                range.vertices = packed.vertices;
+                range.indices = packed.indices;
+            }
+
+            wgpu::CommandBufferDescriptor command_buffer_desc = {};
+            command_buffer_desc.label = "Mesh arena defragment command buffer";
+            auto command = wga::object{encoder.get().finish(command_buffer_desc)};
+            queue.get().submit(1, &command.get());
+
+            // The old buffers are released here, wgpu keeps them alive until the copies have run
+            pages = std::move(packed_pages);
+        }
+    };
+
+    auto create_mesh_arena(wga::object<wgpu::Device> &device) -> wga::mesh_arena {
+        wgpu::SupportedLimits supported_limits;
+        device.get().getLimits(&supported_limits);
+        const auto max_buffer_size = supported_limits.limits.maxBufferSize;
+        return wga::mesh_arena{std::min(wga::default_mesh_vertex_page_size, max_buffer_size),
+                               std::min(wga::default_mesh_index_page_size, max_buffer_size),
+                               max_buffer_size, {}, {}, {}};
+    }
+
+    // Owns a mesh of an arena, which must outlive it
+    struct mesh_handle {
+        wga::mesh_arena *arena{nullptr};
+        wga::mesh_id id{0};
+
+        mesh_handle() = default;
+        mesh_handle(wga::mesh_arena &arena_, wga::mesh_id id_) : arena(&arena_), id(id_) {}
+        ~mesh_handle() {
+            if (arena) {
+                arena->free(id);
+            }
+        }
+        mesh_handle(const mesh_handle &) = delete;
+        mesh_handle(mesh_handle &&other) noexcept: arena(std::exchange(other.arena, nullptr)), id(other.id) {}
+        auto operator=(const mesh_handle &) -> mesh_handle & = delete;
+        auto operator=(mesh_handle &&other) noexcept -> mesh_handle & {
+            if (this != &other) {
+                if (arena) {
+                    arena->free(id);
+                }
+                arena = std::exchange(other.arena, nullptr);
+                id = other.id;
+            }
+            return *this;
+        }
+
+        [[nodiscard]] auto get() const -> const wga::mesh_range & {
+            return arena->get(id);
+        }
+    };
+
+    // What is bound to a render pass, consecutive draws from the same page skip setVertexBuffer/setIndexBuffer
+    struct mesh_bindings {
+        const wga::mesh_arena_page *page{nullptr};
+        WGPUIndexFormat index_format{WGPUIndexFormat_Undefined};
+    };
+
+    void draw(wgpu::RenderPassEncoder &render_pass, const wga::mesh_handle &mesh, std::uint32_t instance_count,
+              wga::mesh_bindings &bindings) {
+        const auto &range = mesh.get();
+        const auto &page = mesh.arena->pages[range.page];
+        if (bindings.page != &page) {
+            render_pass.setVertexBuffer(0, page.vertex_buffer.get(), 0, page.vertices.capacity);
+        }
+        if (bindings.page != &page || bindings.index_format != range.index_format) {
+            render_pass.setIndexBuffer(page.index_buffer.get(), range.index_format, 0, page.indices.capacity);
+        }
+        bindings = {&page, range.index_format};
+        render_pass.drawIndexed(range.index_count, instance_count, range.first_index(), range.base_vertex(), 0);
+    }
+}
+
+#endif //WGA_MESH_ARENA_HPP
@@ -5,23 +5,44 @@
 #ifndef WGA_MODEL_HPP
 #define WGA_MODEL_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <filesystem>
+#include <limits>
+#include <optional>
+#include <utility>
 #include <vector>
 
 #include <wga/setup.hpp>
+#include <wga/instances.hpp>
 #include <wga/geometry/geometry.hpp>
+#include <wga/geometry/mesh_cache.hpp>
+#include <wga/vertex_format.hpp>
 
 namespace wga {
+    // Points and indices live in the context's mesh arena, uploaded with the next staging belt flush or frame
     struct model {
-        wga::object<wgpu::Buffer, true> vertex_buffer;
-        wga::object<wgpu::Buffer, true> index_buffer;
-
-        std::uint32_t index_count;
-        std::size_t point_data_size;
-        std::size_t index_data_size;
+        wga::mesh_handle mesh;
     };
 
+    // header.vertex_stride must be set, indices are Uint32
+    auto create_model(wga::context &context, const wga::geometry::mesh_header &header,
+                      const void *point_data, const void *index_data) -> model {
+        return wga::model{
+                wga::mesh_handle{context.meshes, context.meshes.allocate(
+                        context.device, context.staging_belt, point_data, header.vertex_size, header.vertex_stride,
+                        index_data, header.index_size, static_cast<std::uint32_t>(header.index_count),
+                        wgpu::IndexFormat::Uint32)}
+        };
+    }
+
     auto create_model(wga::context &context, const std::filesystem::path &path, int dimensions) -> model {
+        const auto point_stride = static_cast<std::uint32_t>(static_cast<std::size_t>(dimensions + 3) * sizeof(float));
+        if (auto cache = wga::geometry::open_mesh_cache(path, wga::geometry::mesh_layout::points, 0, point_stride)) {
+            return wga::create_model(context, cache->header, cache->vertex_data(), cache->index_data());
+        }
+
         std::vector<float> point_data;
         std::vector<std::uint32_t> index_data;
 
@@ -29,47 +50,174 @@ namespace wga {
             throw std::runtime_error("Could not load geometry from file!");
         }
 
-        wga::model model{
-                wga::create_buffer(context.device, wga::bytesize(point_data),
-                                   wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex),
-                wga::create_buffer(context.device, wga::bytesize(index_data),
-                                   wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Index),
-                static_cast<std::uint32_t>(index_data.size()),
-                wga::bytesize(point_data),
-                wga::bytesize(index_data)
-        };
+        const auto bounds = wga::geometry::compute_bounds(point_data, dimensions);
+        const auto bounds_radius = wga::geometry::compute_bounding_radius(point_data, dimensions, bounds);
+
+        wga::geometry::mesh_header header{};
+        header.vertex_layout = wga::geometry::mesh_layout::points;
+        header.vertex_stride = point_stride;
+        header.index_format = wga::geometry::mesh_index_format::uint32;
+        header.vertex_count = point_data.size() / static_cast<std::size_t>(dimensions + 3);
+        header.index_count = index_data.size();
+        header.vertex_size = wga::bytesize(point_data);
+        header.index_size = wga::bytesize(index_data);
+        std::memcpy(header.bounds_min, &bounds.min, sizeof(header.bounds_min));
+        std::memcpy(header.bounds_max, &bounds.max, sizeof(header.bounds_max));
+        header.bounds_radius = bounds_radius;
+        wga::geometry::write_mesh_cache(path, header, point_data.data(), index_data.data());
+
+        return wga::create_model(context, header, point_data.data(), index_data.data());
+    }
 
-        context.queue.get().writeBuffer(model.vertex_buffer.get(), 0,
-                                        point_data.data(), wga::bytesize(point_data));
+    // Indices are stored as Uint16 whenever every vertex of the mesh can be addressed with 16 bits
+    auto get_index_format(std::size_t vertex_count) -> wga::geometry::mesh_index_format {
+        return vertex_count <= std::size_t{std::numeric_limits<std::uint16_t>::max()} + 1
+               ? wga::geometry::mesh_index_format::uint16
+               : wga::geometry::mesh_index_format::uint32;
+    }
 
-        context.queue.get().writeBuffer(model.index_buffer.get(), 0,
-                                        index_data.data(), wga::bytesize(index_data));
+    auto to_wgpu_index_format(wga::geometry::mesh_index_format format) -> wgpu::IndexFormat {
+        switch (format) {
+            case wga::geometry::mesh_index_format::uint16:
+                return wgpu::IndexFormat::Uint16;
+            case wga::geometry::mesh_index_format::uint32:
+                return wgpu::IndexFormat::Uint32;
+            default:
+                return wgpu::IndexFormat::Undefined;
+        }
+    }
 
+    struct model_obj {
+        wga::mesh_handle mesh;
+        wga::vertex_format vertex_format;
+        wga::geometry::bounds bounds;
+        float bounds_radius; // bounding sphere around the center of bounds, see wga::cull_bounds
+    };
+
+    // Arena ranges for the mesh described by header, not drawable until they are written
+    auto reserve_model_obj(wga::context &context, const wga::geometry::mesh_header &header,
+                           const wga::vertex_format &vertex_format) -> model_obj {
+        return wga::model_obj{
+                wga::mesh_handle{context.meshes, context.meshes.reserve(
+                        context.device, header.vertex_size, wga::get_vertex_stride(vertex_format), header.index_size,
+                        static_cast<std::uint32_t>(header.index_count),
+                        wga::to_wgpu_index_format(header.index_format))},
+                vertex_format,
+                {{header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]},
+                 {header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]}},
+                header.bounds_radius
+        };
+    }
+
+    auto create_model_obj(wga::context &context, const wga::geometry::mesh_header &header,
+                          const void *vertex_data, const void *index_data,
+                          const wga::vertex_format &vertex_format) -> model_obj {
+        auto model = wga::reserve_model_obj(context, header, vertex_format);
+        context.meshes.write_vertices(context.device, context.staging_belt, model.mesh.id, 0, vertex_data,
+                                      header.vertex_size);
+        context.meshes.write_indices(context.device, context.staging_belt, model.mesh.id, 0, index_data,
+                                     header.index_size);
         return model;
     }
 
-    struct model_obj {
-        wga::object<wgpu::Buffer, true> vertex_buffer;
-        std::size_t vertex_data_size;
-        std::uint32_t index_count;
+    // Everything create_model_obj does before touching the GPU, safe to run on a worker thread
+    struct model_obj_data {
+        wga::geometry::mesh_header header;
+        std::optional<wga::geometry::mesh_cache> cache; // the payloads are read from the mapped cache file if set
+        std::vector<std::byte> vertex_data;
+        std::vector<std::uint32_t> index_data;
+        std::vector<std::uint16_t> narrow_index_data;
+
+        [[nodiscard]] auto vertex_payload() const noexcept -> const void * {
+            return cache ? static_cast<const void *>(cache->vertex_data()) : vertex_data.data();
+        }
+
+        [[nodiscard]] auto index_payload() const noexcept -> const void * {
+            if (cache) {
+                return cache->index_data();
+            }
+            return header.index_format == wga::geometry::mesh_index_format::uint16
+                   ? static_cast<const void *>(narrow_index_data.data()) : index_data.data();
+        }
     };
 
-    auto create_model_obj(wga::context &context, const std::filesystem::path &path) {
+    // Reads the mesh cache, or parses the obj file, encodes it and writes the cache
+    auto load_model_obj_data(const std::filesystem::path &path,
+                             const wga::vertex_format &vertex_format = wga::full_vertex_format) -> model_obj_data {
+        const auto vertex_stride = wga::get_vertex_stride(vertex_format);
+        if (auto cache = wga::geometry::open_mesh_cache(path, wga::geometry::mesh_layout::vertex_attributes,
+                                                        vertex_format.code(), vertex_stride)) {
+            const auto header = cache->header;
+            return wga::model_obj_data{header, std::move(cache), {}, {}, {}};
+        }
+
         std::vector<wga::shader_type::vertex_attributes> vertex_data;
-        if (!wga::geometry::load_obj(path, vertex_data)) {
+        wga::model_obj_data data{};
+        if (!wga::geometry::load_obj(path, vertex_data, data.index_data)) {
             throw std::runtime_error("Could not load geometry!");
         }
+        auto &index_data = data.index_data;
+
+        const auto bounds = wga::geometry::compute_bounds(vertex_data);
+        const auto bounds_radius = wga::geometry::compute_bounding_radius(vertex_data, bounds);
+        data.vertex_data = wga::encode_vertices(vertex_format, vertex_data, bounds.min, bounds.max);
+        const auto &encoded_vertex_data = data.vertex_data;
+
+        auto &header = data.header;
+        header.vertex_layout = wga::geometry::mesh_layout::vertex_attributes;
+        header.vertex_stride = vertex_stride;
+        header.vertex_format = vertex_format.code();
+        header.index_format = wga::get_index_format(vertex_data.size());
+        header.vertex_count = vertex_data.size();
+        header.index_count = index_data.size();
+        header.vertex_size = wga::bytesize(encoded_vertex_data);
+        std::memcpy(header.bounds_min, &bounds.min, sizeof(header.bounds_min));
+        std::memcpy(header.bounds_max, &bounds.max, sizeof(header.bounds_max));
+        header.bounds_radius = bounds_radius;
+
+        if (header.index_format == wga::geometry::mesh_index_format::uint16) {
+            data.narrow_index_data.resize(index_data.size());
+            std::transform(index_data.begin(), index_data.end(), data.narrow_index_data.begin(),
+                           [](std::uint32_t index) { return static_cast<std::uint16_t>(index); });
+            header.index_size = wga::bytesize(data.narrow_index_data);
+            index_data = {};
+        } else {
+            header.index_size = wga::bytesize(index_data);
+        }
 
-        wga::model_obj model{
-                wga::create_buffer(context.device, wga::bytesize(vertex_data),
-                                   wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Vertex),
-                wga::bytesize(vertex_data),
-                static_cast<std::uint32_t>(vertex_data.size())
-        };
+        wga::geometry::write_mesh_cache(path, header, encoded_vertex_data.data(), data.index_payload());
+        return data;
+    }
 
-        context.queue.get().writeBuffer(model.vertex_buffer.get(), 0,
-                                        vertex_data.data(), wga::bytesize(vertex_data));
-        return model;
+    // The vertex format is chosen per model, draw it with a pipeline from wga::create_pipeline(context, vertex_format)
+    auto create_model_obj(wga::context &context, const std::filesystem::path &path,
+                          const wga::vertex_format &vertex_format = wga::full_vertex_format) -> model_obj {
+        const auto data = wga::load_model_obj_data(path, vertex_format);
+        return wga::create_model_obj(context, data.header, data.vertex_payload(), data.index_payload(), vertex_format);
+    }
+
+    // Values for uniforms::position_offset and uniforms::position_scale when drawing model
+    auto get_position_quantization(const wga::model_obj &model) -> std::pair<glm::vec4, glm::vec4> {
+        const auto [offset, scale] = wga::get_position_quantization(model.bounds.min, model.bounds.max);
+        return {glm::vec4(offset, 0.0f), glm::vec4(scale, 0.0f)};
+    }
+
+    // Pass the same bindings to consecutive draws of a render pass to skip rebinding the arena buffers
+    void draw(wgpu::RenderPassEncoder &render_pass, wga::model_obj &model, wga::mesh_bindings &bindings,
+              std::uint32_t instance_count = 1) {
+        wga::draw(render_pass, model.mesh, instance_count, bindings);
+    }
+
+    void draw(wgpu::RenderPassEncoder &render_pass, wga::model_obj &model, std::uint32_t instance_count = 1) {
+        wga::mesh_bindings bindings;
+        wga::draw(render_pass, model.mesh, instance_count, bindings);
+    }
+
+    // One draw call for every instance, needs a pipeline created with instanced = true
+    void draw(wgpu::RenderPassEncoder &render_pass, wga::model_obj &model, wga::instance_buffer &instances) {
+        render_pass.setVertexBuffer(1, instances.buffer.get(), 0,
+                                    instances.count * sizeof(wga::shader_type::instance_attributes));
+        wga::draw(render_pass, model, instances.count);
     }
 }
 
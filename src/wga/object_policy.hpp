@@ -0,0 +1,97 @@
+#ifndef WGA_OBJECT_POLICY_HPP
+#define WGA_OBJECT_POLICY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <wga/type_info.hpp>
+
+// What wga::object does besides owning its handle, chosen at compile time
+namespace wga {
+    // Compiles down to the bare handle
+    struct release_policy {
+        template<typename T>
+        static void on_create() noexcept {}
+
+        template<typename T>
+        static void on_destroy() noexcept {}
+    };
+
+    // Created and live objects of one wgpu type, registered in a lock-free list on first use
+    struct object_counter {
+        const char *type_name;
+        std::atomic<std::int64_t> live{0};
+        std::atomic<std::int64_t> created{0};
+        object_counter *next{nullptr};
+    };
+
+    inline std::atomic<wga::object_counter *> object_counters{nullptr};
+
+    template<typename T>
+    auto get_object_counter() noexcept -> wga::object_counter & {
+        static wga::object_counter *counter = [] {
+            static wga::object_counter instance{wga::type_name<T>()};
+            instance.next = wga::object_counters.load(std::memory_order_relaxed);
+            while (!wga::object_counters.compare_exchange_weak(instance.next, &instance, std::memory_order_release,
+                                                               std::memory_order_relaxed)) {
+            }
+            return &instance;
+        }();
+        return *counter;
+    }
+
+    // Counts live objects per type, without any I/O, see get_object_counts
+    struct instrumented_policy {
+        template<typename T>
+        static void on_create() noexcept {
+            auto &counter = wga::get_object_counter<T>();
+            counter.live.fetch_add(1, std::memory_order_relaxed);
+            counter.created.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        template<typename T>
+        static void on_destroy() noexcept {
+            wga::get_object_counter<T>().live.fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+    // Define WGA_INSTRUMENT_OBJECTS to count objects in optimized builds too
+#if defined(WGA_INSTRUMENT_OBJECTS) || !defined(NDEBUG)
+    using default_object_policy = wga::instrumented_policy;
+#else
+    using default_object_policy = wga::release_policy;
+#endif
+
+    struct object_count {
+        const char *type_name;
+        std::int64_t live;
+        std::int64_t created;
+    };
+
+    // Snapshot of the counters of every type an instrumented wga::object was created for
+    auto get_object_counts() -> std::vector<wga::object_count> {
+        std::vector<wga::object_count> counts;
+        for (auto *counter = wga::object_counters.load(std::memory_order_acquire); counter; counter = counter->next) {
+            counts.push_back({counter->type_name, counter->live.load(std::memory_order_relaxed),
+                              counter->created.load(std::memory_order_relaxed)});
+        }
+        return counts;
+    }
+
+    // Prints types that still have live objects, returns false if there are any
+    bool report_live_objects(std::ostream &stream) {
+        bool clean = true;
+        for (const auto &count: wga::get_object_counts()) {
+            if (count.live != 0) {
+                stream << "Live wga::object<" << count.type_name << ">: " << count.live << " of "
+                       << count.created << " created\n";
+                clean = false;
+            }
+        }
+        return clean;
+    }
+}
+
+#endif //WGA_OBJECT_POLICY_HPP
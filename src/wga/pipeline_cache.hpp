@@ -0,0 +1,400 @@
+#ifndef WGA_PIPELINE_CACHE_HPP
+#define WGA_PIPELINE_CACHE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+#include <wga/thread_pool.hpp>
+
+// Shader modules, pipeline layouts and render pipelines created once per distinct content and shared afterwards
+namespace wga {
+    struct pipeline_cache_stats {
+        std::uint64_t shader_module_hits{0};
+        std::uint64_t shader_module_misses{0};
+        std::uint64_t pipeline_hits{0};
+        std::uint64_t pipeline_misses{0};
+        std::uint64_t permutation_hits{0};
+        std::uint64_t permutation_misses{0};
+    };
+
+    // Field by field serialization of descriptor state, padding bytes are never read so equal states give equal keys
+    struct pipeline_key_writer {
+        std::string key;
+
+        // Handles are written by value, strings through the overload below
+        template<typename T>
+        void add(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void add(const char *text) {
+            const std::string_view view = text ? text : "";
+            add(view.size());
+            key.append(view);
+        }
+
+        void add_constants(std::size_t count, const WGPUConstantEntry *constants) {
+            add(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                add(constants[i].key);
+                add(constants[i].value);
+            }
+        }
+    };
+
+    // Modules and layouts are identified by handle, which is unique as long as the cache that created them lives
+    auto get_render_pipeline_key(const WGPURenderPipelineDescriptor &desc) -> std::string {
+        wga::pipeline_key_writer writer;
+        writer.add(desc.layout);
+
+        writer.add(desc.vertex.module);
+        writer.add(desc.vertex.entryPoint);
+        writer.add_constants(desc.vertex.constantCount, desc.vertex.constants);
+        writer.add(desc.vertex.bufferCount);
+        for (std::size_t i = 0; i < desc.vertex.bufferCount; ++i) {
+            const auto &buffer = desc.vertex.buffers[i];
+            writer.add(buffer.arrayStride);
+            writer.add(buffer.stepMode);
+            writer.add(buffer.attributeCount);
+            for (std::size_t j = 0; j < buffer.attributeCount; ++j) {
+                writer.add(buffer.attributes[j].format);
+                writer.add(buffer.attributes[j].offset);
+                writer.add(buffer.attributes[j].shaderLocation);
+            }
+        }
+
+        writer.add(desc.primitive.topology);
+        writer.add(desc.primitive.stripIndexFormat);
+        writer.add(desc.primitive.frontFace);
+        writer.add(desc.primitive.cullMode);
+
+        writer.add(desc.depthStencil != nullptr);
+        if (const auto *depth_stencil = desc.depthStencil) {
+            writer.add(depth_stencil->format);
+            writer.add(depth_stencil->depthWriteEnabled);
+            writer.add(depth_stencil->depthCompare);
+            for (const auto &face: {depth_stencil->stencilFront, depth_stencil->stencilBack}) {
+                writer.add(face.compare);
+                writer.add(face.failOp);
+                writer.add(face.depthFailOp);
+                writer.add(face.passOp);
+            }
+            writer.add(depth_stencil->stencilReadMask);
+            writer.add(depth_stencil->stencilWriteMask);
+            writer.add(depth_stencil->depthBias);
+            writer.add(depth_stencil->depthBiasSlopeScale);
+            writer.add(depth_stencil->depthBiasClamp);
+        }
+
+        writer.add(desc.multisample.count);
+        writer.add(desc.multisample.mask);
+        writer.add(desc.multisample.alphaToCoverageEnabled);
+
+        writer.add(desc.fragment != nullptr);
+        if (const auto *fragment = desc.fragment) {
+            writer.add(fragment->module);
+            writer.add(fragment->entryPoint);
+            writer.add_constants(fragment->constantCount, fragment->constants);
+            writer.add(fragment->targetCount);
+            for (std::size_t i = 0; i < fragment->targetCount; ++i) {
+                const auto &target = fragment->targets[i];
+                writer.add(target.format);
+                writer.add(target.writeMask);
+                writer.add(target.blend != nullptr);
+                if (target.blend) {
+                    for (const auto &component: {target.blend->color, target.blend->alpha}) {
+                        writer.add(component.operation);
+                        writer.add(component.srcFactor);
+                        writer.add(component.dstFactor);
+                    }
+                }
+            }
+        }
+        return std::move(writer.key);
+    }
+
+    // Deep copy of a render pipeline descriptor that stays valid after the caller's arrays are gone, so the
+    // pipeline can be compiled on another thread. Chained structs are not copied
+    struct render_pipeline_descriptor_storage {
+        wgpu::RenderPipelineDescriptor desc;
+        std::deque<std::string> strings;
+        std::vector<WGPUVertexBufferLayout> buffers;
+        std::vector<std::vector<WGPUVertexAttribute>> attributes;
+        std::vector<WGPUConstantEntry> vertex_constants;
+        std::vector<WGPUConstantEntry> fragment_constants;
+        WGPUDepthStencilState depth_stencil;
+        WGPUFragmentState fragment;
+        std::vector<WGPUColorTargetState> targets;
+        std::vector<WGPUBlendState> blends;
+
+        render_pipeline_descriptor_storage() = default;
+        render_pipeline_descriptor_storage(const render_pipeline_descriptor_storage &) = delete;
+        auto operator=(const render_pipeline_descriptor_storage &) = delete;
+
+        auto copy_string(const char *text) -> const char * {
+            return text ? strings.emplace_back(text).c_str() : nullptr;
+        }
+
+        auto copy_constants(std::vector<WGPUConstantEntry> &storage, std::size_t count,
+                            const WGPUConstantEntry *constants) -> const WGPUConstantEntry * {
+            storage.assign(constants, constants + count);
+            for (auto &constant: storage) {
+                constant.nextInChain = nullptr;
+                constant.key = copy_string(constant.key);
+            }
+            return storage.data();
+        }
+
+        void copy(const WGPURenderPipelineDescriptor &source) {
+            static_cast<WGPURenderPipelineDescriptor &>(desc) = source;
+            desc.nextInChain = nullptr;
+            desc.label = copy_string(source.label);
+
+            desc.vertex.nextInChain = nullptr;
+            desc.vertex.entryPoint = copy_string(source.vertex.entryPoint);
+            desc.vertex.constants = copy_constants(vertex_constants, source.vertex.constantCount,
+                                                   source.vertex.constants);
+            buffers.assign(source.vertex.buffers, source.vertex.buffers + source.vertex.bufferCount);
+            attributes.resize(buffers.size());
+            for (std::size_t i = 0; i < buffers.size(); ++i) {
+                attributes[i].assign(buffers[i].attributes, buffers[i].attributes + buffers[i].attributeCount);
+                buffers[i].attributes = attributes[i].data();
+            }
+            desc.vertex.buffers = buffers.data();
+            desc.primitive.nextInChain = nullptr;
+            desc.multisample.nextInChain = nullptr;
+
+            if (source.depthStencil) {
+                depth_stencil = *source.depthStencil;
+                depth_stencil.nextInChain = nullptr;
+                desc.depthStencil = &depth_stencil;
+            }
+
+            if (source.fragment) {
+                fragment = *source.fragment;
+                fragment.nextInChain = nullptr;
+                fragment.entryPoint = copy_string(source.fragment->entryPoint);
+                fragment.constants = copy_constants(fragment_constants, fragment.constantCount,
+                                                    source.fragment->constants);
+                targets.assign(fragment.targets, fragment.targets + fragment.targetCount);
+                blends.resize(targets.size());
+                for (std::size_t i = 0; i < targets.size(); ++i) {
+                    targets[i].nextInChain = nullptr;
+                    if (targets[i].blend) {
+                        blends[i] = *targets[i].blend;
+                        targets[i].blend = &blends[i];
+                    }
+                }
+                fragment.targets = targets.data();
+                desc.fragment = &fragment;
+            }
+        }
+    };
+
+    // Compile time is measured from the first request until the pipeline is ready
+    struct render_pipeline_entry {
+        wga::object<wgpu::RenderPipeline> pipeline;
+        std::future<wga::object<wgpu::RenderPipeline>> compile; // valid while compiling
+        std::chrono::steady_clock::time_point request_time;
+        double compile_time; // ms
+        std::string label;
+
+        [[nodiscard]] auto ready() const noexcept -> bool {
+            return pipeline.get().operator bool();
+        }
+
+        [[nodiscard]] auto compiling() const noexcept -> bool {
+            return compile.valid();
+        }
+    };
+
+    // The entry's pipeline once it is compiled, fallback until then, a null fallback means the draw is skipped
+    auto get_pipeline(const wga::render_pipeline_entry &entry, wgpu::RenderPipeline fallback = {})
+    -> wgpu::RenderPipeline {
+        return entry.ready() ? entry.pipeline.get() : fallback;
+    }
+
+    // Everything handed out stays owned by the cache, handles are valid as long as it lives.
+    // Lookups hash the full content (std::hash of the WGSL source or serialized descriptor) and compare it on a hit
+    struct pipeline_cache {
+        std::unordered_map<std::string, std::string> shader_sources; // by path, files are read once
+        std::unordered_map<std::string, wga::object<wgpu::ShaderModule>> shader_modules; // by WGSL source
+        std::unordered_map<std::string, wga::object<wgpu::PipelineLayout>> pipeline_layouts; // by bind group layouts
+        std::unordered_map<std::string, wga::render_pipeline_entry> render_pipelines; // by descriptor state
+        // Entries of render_pipelines by a caller defined permutation key, skips building the descriptor and its key
+        std::unordered_map<std::uint64_t, wga::render_pipeline_entry *> permutations;
+        wga::pipeline_cache_stats stats;
+        // Declared last so its threads are joined before the entries they complete are destroyed
+        std::unique_ptr<wga::thread_pool> compile_pool;
+
+        auto get_shader_source(const std::filesystem::path &path) -> const std::string & {
+            auto source = shader_sources.find(path.string());
+            if (source == shader_sources.end()) {
+                source = shader_sources.emplace(path.string(), wga::read_shader_source(path)).first;
+            }
+            return source->second;
+        }
+
+        auto get_shader_module(wga::object<wgpu::Device> &device, const std::string &source) -> wgpu::ShaderModule {
+            if (auto module = shader_modules.find(source); module != shader_modules.end()) {
+                ++stats.shader_module_hits;
+                return module->second.get();
+            }
+            ++stats.shader_module_misses;
+            return shader_modules.emplace(source, wga::create_shader_module(source, device)).first->second.get();
+        }
+
+        auto get_pipeline_layout(wga::object<wgpu::Device> &device,
+                                 const std::vector<WGPUBindGroupLayout> &bind_group_layouts) -> wgpu::PipelineLayout {
+            wga::pipeline_key_writer writer;
+            for (auto bind_group_layout: bind_group_layouts) {
+                writer.add(bind_group_layout);
+            }
+            if (auto layout = pipeline_layouts.find(writer.key); layout != pipeline_layouts.end()) {
+                return layout->second.get();
+            }
+
+            wgpu::PipelineLayoutDescriptor pipeline_layout_desc = wgpu::Default;
+            pipeline_layout_desc.label = "Pipeline layout";
+            pipeline_layout_desc.bindGroupLayoutCount = bind_group_layouts.size();
+            pipeline_layout_desc.bindGroupLayouts = bind_group_layouts.data();
+            return pipeline_layouts.emplace(std::move(writer.key), wga::object{
+                    device.get().createPipelineLayout(pipeline_layout_desc)}).first->second.get();
+        }
+
+        auto find_render_pipeline(const std::string &key) -> wga::render_pipeline_entry * {
+            if (auto entry = render_pipelines.find(key); entry != render_pipelines.end()) {
+                ++stats.pipeline_hits;
+                return &entry->second;
+            }
+            ++stats.pipeline_misses;
+            return nullptr;
+        }
+
+        auto add_render_pipeline(std::string key, const wgpu::RenderPipelineDescriptor &desc)
+        -> wga::render_pipeline_entry & {
+            return render_pipelines.emplace(std::move(key), wga::render_pipeline_entry{
+                    wga::object{wgpu::RenderPipeline{}}, {}, std::chrono::steady_clock::now(), 0.0,
+                    desc.label ? desc.label : ""}).first->second;
+        }
+
+        static void finish_compile(wga::render_pipeline_entry &entry) {
+            try {
+                entry.pipeline = entry.compile.get();
+            } catch (const std::exception &exception) {
+                std::cerr << "Could not compile pipeline " << entry.label << ": " << exception.what() << '\n';
+            }
+            entry.compile_time = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - entry.request_time).count();
+        }
+
+        auto find_permutation(std::uint64_t key) -> wga::render_pipeline_entry * {
+            if (auto entry = permutations.find(key); entry != permutations.end()) {
+                ++stats.permutation_hits;
+                return entry->second;
+            }
+            ++stats.permutation_misses;
+            return nullptr;
+        }
+
+        auto add_permutation(std::uint64_t key, wga::render_pipeline_entry &entry) -> wga::render_pipeline_entry & {
+            permutations.emplace(key, &entry);
+            return entry;
+        }
+
+        // Blocks until the entry's pipeline is compiled
+        auto wait(wga::render_pipeline_entry &entry) -> wgpu::RenderPipeline {
+            if (entry.compiling()) {
+                finish_compile(entry);
+            }
+            return entry.pipeline.get();
+        }
+
+        // Blocking, desc must only refer to modules and layouts from this cache
+        auto get_render_pipeline(wga::object<wgpu::Device> &device, const wgpu::RenderPipelineDescriptor &desc)
+        -> wgpu::RenderPipeline {
+            return wait(get_render_pipeline_entry(device, desc));
+        }
+
+        auto get_render_pipeline_entry(wga::object<wgpu::Device> &device, const wgpu::RenderPipelineDescriptor &desc)
+        -> wga::render_pipeline_entry & {
+            auto key = wga::get_render_pipeline_key(desc);
+            auto *entry = find_render_pipeline(key);
+            if (!entry) {
+                entry = &add_render_pipeline(std::move(key), desc);
+                entry->pipeline = wga::object{device.get().createRenderPipeline(desc)};
+                entry->compile_time = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - entry->request_time).count();
+            }
+            return *entry;
+        }
+
+        // Non-blocking: the first request queues the compilation and returns an entry that is not ready yet, see
+        // update and get_pipeline. The returned reference stays valid as long as the cache lives.
+        // wgpu-native does not implement createRenderPipelineAsync, so the blocking call runs on a compile thread
+        auto request_render_pipeline(wga::object<wgpu::Device> &device, const wgpu::RenderPipelineDescriptor &desc)
+        -> wga::render_pipeline_entry & {
+            auto key = wga::get_render_pipeline_key(desc);
+            if (auto *entry = find_render_pipeline(key)) {
+                return *entry;
+            }
+
+            auto &entry = add_render_pipeline(std::move(key), desc);
+            auto storage = std::make_shared<wga::render_pipeline_descriptor_storage>();
+            storage->copy(desc);
+            if (!compile_pool) {
+                compile_pool = std::make_unique<wga::thread_pool>(1);
+            }
+            entry.compile = compile_pool->submit([device = device.get(), storage]() mutable {
+                return wga::object{device.createRenderPipeline(storage->desc)};
+            });
+            return entry;
+        }
+
+        // Swaps in pipelines whose compilation finished, call once per frame
+        void update() {
+            for (auto &[key, entry]: render_pipelines) {
+                if (entry.compiling() &&
+                    entry.compile.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    finish_compile(entry);
+                    std::clog << "Compiled pipeline " << entry.label << " in " << entry.compile_time << " ms\n";
+                }
+            }
+        }
+
+        void print_stats(std::ostream &stream) const {
+            double max_compile_time = 0.0;
+            double total_compile_time = 0.0;
+            for (const auto &[key, entry]: render_pipelines) {
+                max_compile_time = std::max(max_compile_time, entry.compile_time);
+                total_compile_time += entry.compile_time;
+            }
+            stream << "Pipeline cache: " << render_pipelines.size() << " pipelines, " << stats.pipeline_hits
+                   << " hits, " << stats.pipeline_misses << " misses, compile ms total " << total_compile_time
+                   << " max " << max_compile_time << "; " << shader_modules.size()
+                   << " shader modules, " << stats.shader_module_hits << " hits, " << stats.shader_module_misses
+                   << " misses; " << permutations.size() << " permutations, " << stats.permutation_hits
+                   << " hits, " << stats.permutation_misses << " misses\n";
+        }
+    };
+}
+
+#endif //WGA_PIPELINE_CACHE_HPP
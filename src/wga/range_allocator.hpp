@@ -0,0 +1,275 @@
+#ifndef WGA_RANGE_ALLOCATOR_HPP
+#define WGA_RANGE_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Two level segregated fit (TLSF) allocator of ranges of an externally owned buffer, O(1) allocate and free
+namespace wga {
+    static constexpr std::uint32_t invalid_range_node = ~std::uint32_t{0};
+
+    struct range_allocation {
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint32_t node;
+    };
+
+    // Index of the highest set bit, value must not be 0
+    auto get_highest_bit(std::uint64_t value) noexcept -> std::uint32_t {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<std::uint32_t>(__builtin_clzll(value));
+#else
+        std::uint32_t bit = 0;
+        while (value >>= 1) {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // Index of the lowest set bit, value must not be 0
+    auto get_lowest_bit(std::uint64_t value) noexcept -> std::uint32_t {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::uint32_t>(__builtin_ctzll(value));
+#else
+        std::uint32_t bit = 0;
+        while ((value & 1) == 0) {
+            value >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    struct range_node {
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint32_t previous_physical;
+        std::uint32_t next_physical;
+        std::uint32_t previous_free;
+        std::uint32_t next_free;
+        bool used;
+    };
+
+    // Free ranges are binned by the power of two of their size (first level), split linearly into
+    // second_level_count bins (second level), bitmaps of non-empty bins find a large enough range without searching
+    struct range_allocator {
+        static constexpr std::uint32_t second_level_log2 = 4;
+        static constexpr std::uint32_t second_level_count = 1u << second_level_log2;
+        static constexpr std::uint32_t first_level_count = 64 - second_level_log2 + 1;
+
+        std::uint64_t capacity{0};
+        std::uint64_t free_size{0};
+        std::vector<wga::range_node> nodes;
+        std::vector<std::uint32_t> unused_nodes;
+        std::uint64_t first_level_bitmap{0};
+        std::array<std::uint32_t, first_level_count> second_level_bitmaps{};
+        std::array<std::uint32_t, first_level_count * second_level_count> free_lists{};
+
+        static auto get_bin(std::uint64_t size) noexcept -> std::pair<std::uint32_t, std::uint32_t> {
+            if (size < second_level_count) {
+                return {0, static_cast<std::uint32_t>(size)};
+            }
+            const auto bit = wga::get_highest_bit(size);
+            return {bit - second_level_log2 + 1,
+                    static_cast<std::uint32_t>(size >> (bit - second_level_log2)) - second_level_count};
+        }
+
+        auto create_node(const wga::range_node &node) -> std::uint32_t {
+            if (!unused_nodes.empty()) {
+                const auto index = unused_nodes.back();
+                unused_nodes.pop_back();
+                nodes[index] = node;
+                return index;
+            }
+            nodes.push_back(node);
+            return static_cast<std::uint32_t>(nodes.size() - 1);
+        }
+
+        void insert_free(std::uint32_t index) {
+            auto &node = nodes[index];
+            const auto [first, second] = get_bin(node.size);
+            auto &head = free_lists[first * second_level_count + second];
+
+            node.used = false;
+            node.previous_free = wga::invalid_range_node;
+            node.next_free = head;
+            if (head != wga::invalid_range_node) {
+                nodes[head].previous_free = index;
+            }
+            head = index;
+
+            first_level_bitmap |= std::uint64_t{1} << first;
+            second_level_bitmaps[first] |= 1u << second;
+            free_size += node.size;
+        }
+
+        void remove_free(std::uint32_t index) {
+            auto &node = nodes[index];
+            const auto [first, second] = get_bin(node.size);
+            auto &head = free_lists[first * second_level_count + second];
+
+            if (node.previous_free != wga::invalid_range_node) {
+                nodes[node.previous_free].next_free = node.next_free;
+            }
+            if (node.next_free != wga::invalid_range_node) {
+                nodes[node.next_free].previous_free = node.previous_free;
+            }
+            if (head == index) {
+                head = node.next_free;
+                if (head == wga::invalid_range_node) {
+                    second_level_bitmaps[first] &= ~(1u << second);
+                    if (second_level_bitmaps[first] == 0) {
+                        first_level_bitmap &= ~(std::uint64_t{1} << first);
+                    }
+                }
+            }
+            free_size -= node.size;
+        }
+
+        // A free range of at least size bytes: size is rounded up to the next bin so every range in it fits
+        [[nodiscard]] auto find_free(std::uint64_t size) const noexcept -> std::uint32_t {
+            if (size >= second_level_count) {
+                size += (std::uint64_t{1} << (wga::get_highest_bit(size) - second_level_log2)) - 1;
+            }
+            auto [first, second] = get_bin(size);
+            if (first >= first_level_count) {
+                return wga::invalid_range_node;
+            }
+
+            auto second_level_bitmap = second < second_level_count ? second_level_bitmaps[first] & (~0u << second) : 0u;
+            if (second_level_bitmap == 0) {
+                const auto first_level = first + 1 < 64 ? first_level_bitmap & (~std::uint64_t{0} << (first + 1)) : 0;
+                if (first_level == 0) {
+                    return wga::invalid_range_node;
+                }
+                first = wga::get_lowest_bit(first_level);
+                second_level_bitmap = second_level_bitmaps[first];
+            }
+            second = wga::get_lowest_bit(second_level_bitmap);
+            return free_lists[first * second_level_count + second];
+        }
+
+        // Splits the range [offset, offset + size) off the front of node, the rest becomes a new free node
+        void split(std::uint32_t index, std::uint64_t size) {
+            auto remainder = wga::range_node{nodes[index].offset + size, nodes[index].size - size, index,
+                                             nodes[index].next_physical, wga::invalid_range_node,
+                                             wga::invalid_range_node, false};
+            const auto remainder_index = create_node(remainder);
+            auto &node = nodes[index];
+            if (node.next_physical != wga::invalid_range_node) {
+                nodes[node.next_physical].previous_physical = remainder_index;
+            }
+            node.next_physical = remainder_index;
+            node.size = size;
+            insert_free(remainder_index);
+        }
+
+        // Returns std::nullopt if there is no free range large enough, alignment does not need to be a power of two
+        auto allocate(std::uint64_t size, std::uint64_t alignment = 1) -> std::optional<wga::range_allocation> {
+            if (size == 0 || alignment == 0) {
+                return std::nullopt;
+            }
+            auto index = find_free(size + alignment - 1);
+            if (index == wga::invalid_range_node) {
+                return std::nullopt;
+            }
+            remove_free(index);
+
+            const auto padding = (alignment - nodes[index].offset % alignment) % alignment;
+            if (padding > 0) {
+                // The padding stays free, the allocation continues in the second half of the split
+                split(index, padding);
+                const auto padding_index = index;
+                index = nodes[padding_index].next_physical;
+                remove_free(index);
+                insert_free(padding_index);
+            }
+            if (nodes[index].size > size) {
+                split(index, size);
+            }
+            nodes[index].used = true;
+            return wga::range_allocation{nodes[index].offset, size, index};
+        }
+
+        // Merges the range with free neighbours
+        void free(const wga::range_allocation &allocation) {
+            auto index = allocation.node;
+            if (index == wga::invalid_range_node || !nodes[index].used) {
+                return;
+            }
+
+            const auto previous = nodes[index].previous_physical;
+            if (previous != wga::invalid_range_node && !nodes[previous].used) {
+                remove_free(previous);
+                merge(previous, index);
+                index = previous;
+            }
+            const auto next = nodes[index].next_physical;
+            if (next != wga::invalid_range_node && !nodes[next].used) {
+                remove_free(next);
+                merge(index, next);
+            }
+            insert_free(index);
+        }
+
+        // Appends next to its physical predecessor and recycles next
+        void merge(std::uint32_t index, std::uint32_t next) {
+            nodes[index].size += nodes[next].size;
+            nodes[index].next_physical = nodes[next].next_physical;
+            if (nodes[next].next_physical != wga::invalid_range_node) {
+                nodes[nodes[next].next_physical].previous_physical = index;
+            }
+            nodes[next].used = false;
+            unused_nodes.push_back(next);
+        }
+
+        [[nodiscard]] auto get_largest_free() const noexcept -> std::uint64_t {
+            if (first_level_bitmap == 0) {
+                return 0;
+            }
+            const auto first = wga::get_highest_bit(first_level_bitmap);
+            const auto second = wga::get_highest_bit(second_level_bitmaps[first]);
+            std::uint64_t largest = 0;
+            for (auto index = free_lists[first * second_level_count + second];
+                 index != wga::invalid_range_node; index = nodes[index].next_free) {
+                largest = std::max(largest, nodes[index].size);
+            }
+            return largest;
+        }
+
+        // 0 when all free space is one range, approaching 1 as it is scattered into small holes
+        [[nodiscard]] auto get_fragmentation() const noexcept -> double {
+            return free_size == 0 ? 0.0 : 1.0 - static_cast<double>(get_largest_free()) / static_cast<double>(free_size);
+        }
+    };
+
+    // Smallest capacity at which a new allocator is certain to allocate size bytes with alignment, find_free rounds
+    // the request up to the next bin
+    auto get_range_allocator_capacity(std::uint64_t size, std::uint64_t alignment = 1) noexcept -> std::uint64_t {
+        constexpr auto second_level_log2 = wga::range_allocator::second_level_log2;
+        auto request = size + alignment - 1;
+        if (request >= wga::range_allocator::second_level_count) {
+            request += (std::uint64_t{1} << (wga::get_highest_bit(request) - second_level_log2)) - 1;
+        }
+        return request;
+    }
+
+    auto create_range_allocator(std::uint64_t capacity) -> wga::range_allocator {
+        wga::range_allocator allocator;
+        allocator.capacity = capacity;
+        allocator.free_lists.fill(wga::invalid_range_node);
+        if (capacity > 0) {
+            allocator.insert_free(allocator.create_node(
+                    {0, capacity, wga::invalid_range_node, wga::invalid_range_node, wga::invalid_range_node,
+                     wga::invalid_range_node, false}));
+        }
+        return allocator;
+    }
+}
+
+#endif //WGA_RANGE_ALLOCATOR_HPP
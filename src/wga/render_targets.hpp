@@ -0,0 +1,118 @@
+#ifndef WGA_RENDER_TARGETS_HPP
+#define WGA_RENDER_TARGETS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+
+// Attachments kept alive across frames, so a frame only allocates when the window size changes
+namespace wga {
+    struct render_target_key {
+        WGPUTextureFormat format;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t sample_count;
+        WGPUTextureUsageFlags usage;
+
+        auto operator==(const render_target_key &other) const noexcept -> bool {
+            return format == other.format && width == other.width && height == other.height &&
+                   sample_count == other.sample_count && usage == other.usage;
+        }
+    };
+
+    struct render_target {
+        wga::render_target_key key;
+        wga::object<wgpu::Texture, true> texture;
+        wga::object<wgpu::TextureView> view;
+        std::uint64_t last_used_frame;
+        bool in_use;
+    };
+
+    auto is_depth_format(WGPUTextureFormat format) noexcept -> bool {
+        return format == WGPUTextureFormat_Depth16Unorm || format == WGPUTextureFormat_Depth24Plus ||
+               format == WGPUTextureFormat_Depth32Float;
+    }
+
+    auto create_render_target(wga::object<wgpu::Device> &device, const wga::render_target_key &key,
+                              std::uint64_t frame) -> std::unique_ptr<wga::render_target> {
+        wgpu::TextureDescriptor texture_desc;
+        texture_desc.dimension = wgpu::TextureDimension::_2D;
+        texture_desc.format = key.format;
+        texture_desc.mipLevelCount = 1;
+        texture_desc.sampleCount = key.sample_count;
+        texture_desc.size = {key.width, key.height, 1};
+        texture_desc.usage = key.usage;
+        texture_desc.viewFormatCount = 0;
+        texture_desc.viewFormats = nullptr;
+        auto texture = wga::object<wgpu::Texture, true>{device.get().createTexture(texture_desc)};
+
+        wgpu::TextureViewDescriptor view_desc;
+        view_desc.aspect = wga::is_depth_format(key.format) ? wgpu::TextureAspect::DepthOnly : wgpu::TextureAspect::All;
+        view_desc.baseArrayLayer = 0;
+        view_desc.arrayLayerCount = 1;
+        view_desc.baseMipLevel = 0;
+        view_desc.mipLevelCount = 1;
+        view_desc.dimension = wgpu::TextureViewDimension::_2D;
+        view_desc.format = key.format;
+        auto view = wga::object{texture.get().createView(view_desc)};
+
+        return std::make_unique<wga::render_target>(
+                wga::render_target{key, std::move(texture), std::move(view), frame, true});
+    }
+
+    // Targets are handed out by key, a released target can be reused by a later pass of the same frame
+    struct render_target_pool {
+        // Targets not used for this many frames, e.g. those of the old size after a resize, are destroyed
+        static constexpr std::uint64_t max_idle_frames = 3;
+
+        std::vector<std::unique_ptr<wga::render_target>> targets;
+        std::uint64_t frame{0};
+
+        auto acquire(wga::object<wgpu::Device> &device, const wga::render_target_key &key) -> wga::render_target & {
+            for (auto &target: targets) {
+                if (!target->in_use && target->key == key) {
+                    target->in_use = true;
+                    target->last_used_frame = frame;
+                    return *target;
+                }
+            }
+            return *targets.emplace_back(wga::create_render_target(device, key, frame));
+        }
+
+        // Target of key handed out in this frame, without acquiring another one, nullptr if there is none
+        auto find(const wga::render_target_key &key) noexcept -> wga::render_target * {
+            for (auto &target: targets) {
+                if (target->in_use && target->last_used_frame == frame && target->key == key) {
+                    return target.get();
+                }
+            }
+            return nullptr;
+        }
+
+        // Only needed for transient targets, everything is released at the start of the next frame
+        void release(wga::render_target &target) noexcept {
+            target.in_use = false;
+        }
+
+        void begin_frame() {
+            ++frame;
+            targets.erase(std::remove_if(targets.begin(), targets.end(), [this](const auto &target) {
+                return frame - target->last_used_frame > max_idle_frames;
+            }), targets.end());
+            for (auto &target: targets) {
+                target->in_use = false;
+            }
+        }
+
+        void clear() {
+            targets.clear();
+        }
+    };
+}
+
+#endif //WGA_RENDER_TARGETS_HPP
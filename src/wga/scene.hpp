@@ -0,0 +1,79 @@
+#ifndef WGA_SCENE_HPP
+#define WGA_SCENE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <wga/bvh.hpp>
+#include <wga/culling.hpp>
+#include <wga/thread_pool.hpp>
+#include <wga/geometry/geometry.hpp>
+
+// Objects placed in the world by a transform, culled and picked through a BVH over their world bounds
+namespace wga {
+    // A refit tree is rebuilt once its SAH cost exceeds the cost it was built with by this factor
+    static constexpr float scene_rebuild_ratio = 1.5f;
+
+    struct scene {
+        std::vector<glm::mat4x4> transforms;
+        std::vector<wga::geometry::bounds> local_bounds; // see wga::model_obj::bounds
+        std::vector<wga::geometry::bounds> world_bounds;
+        wga::bvh bvh;
+        bool moved{false}; // objects moved since the last update, the tree needs a refit
+        bool added{false}; // objects were added since the last update, the tree needs a rebuild
+    };
+
+    auto add_object(wga::scene &scene, const glm::mat4x4 &transform, const wga::geometry::bounds &bounds)
+    -> std::uint32_t {
+        scene.transforms.push_back(transform);
+        scene.local_bounds.push_back(bounds);
+        scene.world_bounds.push_back(wga::geometry::transform_bounds(transform, bounds));
+        scene.added = true;
+        return static_cast<std::uint32_t>(scene.transforms.size() - 1);
+    }
+
+    void set_transform(wga::scene &scene, std::uint32_t index, const glm::mat4x4 &transform) {
+        scene.transforms[index] = transform;
+        scene.world_bounds[index] = wga::geometry::transform_bounds(transform, scene.local_bounds[index]);
+        scene.moved = true;
+    }
+
+    // Brings the tree up to date with the world bounds, call once per frame after moving objects and before culling
+    // or picking. Refitting costs one pass over the nodes, a rebuild runs on pool if one is given
+    void update_scene(wga::thread_pool *pool, wga::scene &scene) {
+        if (scene.moved && !scene.added) {
+            wga::refit_bvh(scene.bvh, scene.world_bounds);
+            scene.added = wga::get_sah_cost(scene.bvh) > wga::scene_rebuild_ratio * scene.bvh.built_cost;
+        }
+        if (scene.added) {
+            scene.bvh = wga::build_bvh(pool, scene.world_bounds);
+        }
+        scene.moved = false;
+        scene.added = false;
+    }
+
+    // Indices of the objects intersecting frustum, in tree order rather than index order
+    void cull(const wga::frustum &frustum, const wga::scene &scene, std::vector<std::uint32_t> &visible) {
+        wga::cull_bvh(frustum, scene.bvh, scene.world_bounds, visible);
+    }
+
+    // Closest object whose world bounds ray hits
+    auto pick(const wga::scene &scene, const wga::ray &ray) -> std::optional<wga::bvh_hit> {
+        return wga::intersect_bvh(scene.bvh, scene.world_bounds, ray);
+    }
+
+    // Ray from the near to the far plane through a point in normalized device coordinates, e.g. under the cursor
+    auto get_ray(const glm::mat4x4 &view_projection, const glm::vec2 &point) -> wga::ray {
+        const auto inverse = glm::inverse(view_projection);
+        const auto near_point = inverse * glm::vec4(point, 0.0f, 1.0f);
+        const auto far_point = inverse * glm::vec4(point, 1.0f, 1.0f);
+        const auto origin = glm::vec3(near_point) / near_point.w;
+        return {origin, glm::vec3(far_point) / far_point.w - origin};
+    }
+}
+
+#endif //WGA_SCENE_HPP
@@ -5,23 +5,48 @@
 #ifndef WGA_SETUP_HPP
 #define WGA_SETUP_HPP
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
 
 #include <wga/wga.hpp>
 #include <wga/callbacks.hpp>
+#include <wga/instances.hpp>
+#include <wga/mesh_arena.hpp>
+#include <wga/pipeline_cache.hpp>
+#include <wga/render_targets.hpp>
+#include <wga/shader_features.hpp>
+#include <wga/staging_belt.hpp>
+#include <wga/texture.hpp>
+#include <wga/uniform_ring.hpp>
+#include <wga/vertex_format.hpp>
 
 namespace wga {
     struct context {
         wgpu::TextureFormat depth_texture_format;
+        std::uint32_t width;
+        std::uint32_t height;
+        wgpu::PresentMode present_mode;
         wga::object<wgpu::Instance> instance;
-        wga::object<wgpu::Surface> surface;
+        std::optional<wga::object<wgpu::Surface>> surface; // empty for headless contexts
         wga::object<wgpu::Adapter> adapter;
+        wgpu::TextureFormat color_format;
         wga::object<wgpu::Device> device;
-        wga::object<wgpu::SwapChain> swapchain;
+        std::optional<wga::object<wgpu::SwapChain>> swapchain;
         wga::object<wgpu::Buffer, true> uniform_buffer;
+        wga::uniform_ring uniform_ring;
         wga::object<wgpu::BindGroupLayout> bind_group_layout;
-        wga::object<wgpu::RenderPipeline> pipeline;
+        wga::pipeline_cache pipelines;
+        wgpu::RenderPipeline pipeline; // owned by pipelines
         wga::object<wgpu::Queue> queue;
+        wga::render_target_pool render_targets;
+        wga::staging_belt staging_belt;
+        wga::mesh_arena meshes; // models refer to it, so the context must not move once they exist
+        std::optional<wga::mipmap_generator> mipmaps; // created by the first texture upload
 
         context() = delete;
         ~context() = default;
@@ -38,7 +63,7 @@ namespace wga {
     }
 
     auto create_bind_group_layout(wga::object<wgpu::Device> &device) {
-        std::vector<wgpu::BindGroupLayoutEntry> binding_layout_entries(2, wgpu::Default);
+        std::vector<wgpu::BindGroupLayoutEntry> binding_layout_entries(3, wgpu::Default);
 
         wgpu::BindGroupLayoutEntry& binding_layout = binding_layout_entries[0];
         binding_layout.binding = 0;
@@ -51,7 +76,12 @@ namespace wga {
         texture_binding_layout.binding = 1;
         texture_binding_layout.visibility = wgpu::ShaderStage::Fragment;
         texture_binding_layout.texture.sampleType = wgpu::TextureSampleType::Float;
-        texture_binding_layout.texture.viewDimension = wgpu::TextureViewDimension::_2D;
+        texture_binding_layout.texture.viewDimension = wgpu::TextureViewDimension::_2DArray;
+
+        wgpu::BindGroupLayoutEntry& sampler_binding_layout = binding_layout_entries[2];
+        sampler_binding_layout.binding = 2;
+        sampler_binding_layout.visibility = wgpu::ShaderStage::Fragment;
+        sampler_binding_layout.sampler.type = wgpu::SamplerBindingType::Filtering;
 
         wgpu::BindGroupLayoutDescriptor bind_group_layout_desc{};
         bind_group_layout_desc.entryCount = static_cast<std::uint32_t>(binding_layout_entries.size());
@@ -60,9 +90,10 @@ namespace wga {
     }
 
     auto create_bind_group(wga::object<wgpu::Device> &device, wga::object<wgpu::Buffer, true> &uniform_buffer,
-                           wga::object<wgpu::BindGroupLayout> &bind_group_layout, wga::object<wgpu::TextureView>& texture_view) {
+                           wga::object<wgpu::BindGroupLayout> &bind_group_layout, wga::object<wgpu::TextureView>& texture_view,
+                           wga::object<wgpu::Sampler> &sampler) {
 
-        std::vector<wgpu::BindGroupEntry> bindings(2);
+        std::vector<wgpu::BindGroupEntry> bindings(3);
         bindings[0].binding = 0;
         bindings[0].buffer = uniform_buffer.get();
         bindings[0].offset = 0;
@@ -71,6 +102,9 @@ namespace wga {
         bindings[1].binding = 1;
         bindings[1].textureView = texture_view.get();
 
+        bindings[2].binding = 2;
+        bindings[2].sampler = sampler.get();
+
         wgpu::BindGroupDescriptor bind_group_desc{};
         bind_group_desc.layout = bind_group_layout.get();
         bind_group_desc.entryCount = static_cast<std::uint32_t>(bindings.size());
@@ -79,11 +113,24 @@ namespace wga {
         return wga::object{std::forward<wgpu::BindGroup>(bind_group)};
     }
 
-    auto create_pipeline(wga::object<wgpu::Surface> &surface, wga::object<wgpu::Adapter> &adapter,
-                         wga::object<wgpu::Device> &device,
-                         wga::object<wgpu::BindGroupLayout> &bind_group_layout, wgpu::TextureFormat &format) {
-
-        auto shader_module = wga::create_shader_module("../data/shaders/basic_color.wgsl", device);
+    // Builds the descriptor of the basic pipeline and hands it to create, which returns the cache entry. Permutations
+    // that were built before are looked up by key without building the descriptor again
+    template<typename F>
+    auto build_pipeline(wga::pipeline_cache &pipelines, wgpu::TextureFormat color_format,
+                        wga::object<wgpu::Device> &device,
+                        wga::object<wgpu::BindGroupLayout> &bind_group_layout, wgpu::TextureFormat &format,
+                        const wga::vertex_format &vertex_format, bool instanced,
+                        const wga::shader_features &features, F &&create) -> wga::render_pipeline_entry & {
+        const auto permutation_key = wga::get_permutation_key(color_format, format, vertex_format, instanced,
+                                                              features);
+        if (auto *entry = pipelines.find_permutation(permutation_key)) {
+            return *entry;
+        }
+
+        const auto constants = wga::get_shader_constants(features);
+        auto shader_module = pipelines.get_shader_module(
+                device, constants.declarations + wga::get_vertex_input_source(vertex_format) +
+                        pipelines.get_shader_source("../data/shaders/basic_color.wgsl"));
 
         wgpu::BlendState blend_state;
         blend_state.color.srcFactor = wgpu::BlendFactor::SrcAlpha;
@@ -94,55 +141,32 @@ namespace wga {
         blend_state.alpha.operation = wgpu::BlendOperation::Add;
 
         wgpu::ColorTargetState color_target;
-        color_target.format = get_swapchain_format(surface, adapter);
+        color_target.format = color_format;
         color_target.blend = &blend_state;
         color_target.writeMask = wgpu::ColorWriteMask::All;
 
         wgpu::FragmentState fragment_state;
-        fragment_state.module = shader_module.get();
+        fragment_state.module = shader_module;
         fragment_state.entryPoint = "fs_main";
-        fragment_state.constantCount = 0;
-        fragment_state.constants = nullptr;
+        fragment_state.constantCount = constants.entries.size();
+        fragment_state.constants = constants.entries.data();
         fragment_state.targetCount = 1;
         fragment_state.targets = &color_target;
 
-        wgpu::VertexAttribute vertex_pos_attrib;
-        vertex_pos_attrib.shaderLocation = 0; // @location(0)
-        vertex_pos_attrib.format = wgpu::VertexFormat::Float32x3;
-        vertex_pos_attrib.offset = offsetof(wga::shader_type::vertex_attributes, position);
-
-        wgpu::VertexAttribute vertex_normal_attrib;
-        vertex_normal_attrib.shaderLocation = 1; // @location(1)
-        vertex_normal_attrib.format = wgpu::VertexFormat::Float32x3;
-        vertex_normal_attrib.offset = offsetof(wga::shader_type::vertex_attributes, normal);
-
-        wgpu::VertexAttribute vertex_color_attrib;
-        vertex_color_attrib.shaderLocation = 2; // @location(2)
-        vertex_color_attrib.format = wgpu::VertexFormat::Float32x3;
-        vertex_color_attrib.offset = offsetof(wga::shader_type::vertex_attributes, color);
-
-        wgpu::VertexAttribute vertex_uv_attrib;
-        vertex_uv_attrib.shaderLocation = 3; // @location(3)
-        vertex_uv_attrib.format = wgpu::VertexFormat::Float32x2;
-        vertex_uv_attrib.offset = offsetof(wga::shader_type::vertex_attributes, uv);
-
-        std::vector<wgpu::VertexAttribute> vertex_attrib{
-                vertex_pos_attrib,
-                vertex_normal_attrib,
-                vertex_color_attrib,
-                vertex_uv_attrib};
-
-        wgpu::VertexBufferLayout vertex_buffer_layout;
+        const auto vertex_attrib = wga::get_vertex_attributes(vertex_format);
+
+        std::array<wgpu::VertexBufferLayout, 2> vertex_buffer_layouts;
+        wgpu::VertexBufferLayout &vertex_buffer_layout = vertex_buffer_layouts[0];
         vertex_buffer_layout.attributeCount = static_cast<std::uint32_t>(vertex_attrib.size());
         vertex_buffer_layout.attributes = vertex_attrib.data();
-        vertex_buffer_layout.arrayStride = sizeof(wga::shader_type::vertex_attributes);
+        vertex_buffer_layout.arrayStride = wga::get_vertex_stride(vertex_format);
         vertex_buffer_layout.stepMode = wgpu::VertexStepMode::Vertex;
 
-        wgpu::PipelineLayoutDescriptor pipeline_layout_desc = wgpu::Default;
-        pipeline_layout_desc.label = "Pipeline layout";
-        pipeline_layout_desc.bindGroupLayoutCount = 1;
-        pipeline_layout_desc.bindGroupLayouts = reinterpret_cast<WGPUBindGroupLayout *>(&bind_group_layout.get());
-        wgpu::PipelineLayout layout = device.get().createPipelineLayout(pipeline_layout_desc);
+        // Slot 1 advances once per instance
+        vertex_buffer_layouts[1] = wga::vertex_layout<wga::shader_type::instance_attributes>::buffer_layout(
+                WGPUVertexStepMode_Instance);
+
+        const auto layout = pipelines.get_pipeline_layout(device, {bind_group_layout.get()});
 
         wgpu::DepthStencilState depth_stencil_state = wgpu::Default;
         depth_stencil_state.depthCompare = wgpu::CompareFunction::Less;
@@ -153,10 +177,10 @@ namespace wga {
 
         wgpu::RenderPipelineDescriptor desc;
         desc.label = "Render pipeline";
-        desc.vertex.bufferCount = 1;
-        desc.vertex.buffers = &vertex_buffer_layout;
-        desc.vertex.module = shader_module.get();
-        desc.vertex.entryPoint = "vs_main";
+        desc.vertex.bufferCount = instanced ? 2 : 1;
+        desc.vertex.buffers = vertex_buffer_layouts.data();
+        desc.vertex.module = shader_module;
+        desc.vertex.entryPoint = instanced ? "vs_instanced" : "vs_main";
         desc.vertex.constantCount = 0;
         desc.vertex.constants = nullptr;
         desc.primitive.topology = wgpu::PrimitiveTopology::TriangleList;
@@ -170,29 +194,437 @@ namespace wga {
         desc.multisample.alphaToCoverageEnabled = false;
         desc.layout = layout;
 
-        return wga::object<wgpu::RenderPipeline>{device.get().createRenderPipeline(desc)};
+        return pipelines.add_permutation(permutation_key, create(desc));
+    }
+
+    // Identical requests return the same pipeline from the cache, which owns it
+    auto create_pipeline(wga::pipeline_cache &pipelines, wgpu::TextureFormat color_format,
+                         wga::object<wgpu::Device> &device,
+                         wga::object<wgpu::BindGroupLayout> &bind_group_layout, wgpu::TextureFormat &format,
+                         const wga::vertex_format &vertex_format = wga::full_vertex_format,
+                         bool instanced = false,
+                         const wga::shader_features &features = {}) -> wgpu::RenderPipeline {
+        return pipelines.wait(wga::build_pipeline(
+                pipelines, color_format, device, bind_group_layout, format, vertex_format, instanced, features,
+                [&](const wgpu::RenderPipelineDescriptor &desc) -> wga::render_pipeline_entry & {
+                    return pipelines.get_render_pipeline_entry(device, desc);
+                }));
+    }
+
+    // Compiles in the background, the entry is ready some frames later, see wga::pipeline_cache::update
+    auto request_pipeline(wga::pipeline_cache &pipelines, wgpu::TextureFormat color_format,
+                          wga::object<wgpu::Device> &device,
+                          wga::object<wgpu::BindGroupLayout> &bind_group_layout, wgpu::TextureFormat &format,
+                          const wga::vertex_format &vertex_format = wga::full_vertex_format,
+                          bool instanced = false,
+                          const wga::shader_features &features = {}) -> wga::render_pipeline_entry & {
+        return wga::build_pipeline(
+                pipelines, color_format, device, bind_group_layout, format, vertex_format, instanced, features,
+                [&](const wgpu::RenderPipelineDescriptor &desc) -> wga::render_pipeline_entry & {
+                    return pipelines.request_render_pipeline(device, desc);
+                });
+    }
+
+    // Depth prepass pipeline without a fragment stage, binds only the position stream of wga::split_vertex_streams
+    auto create_depth_pipeline(wga::pipeline_cache &pipelines, wga::object<wgpu::Device> &device,
+                               wga::object<wgpu::BindGroupLayout> &bind_group_layout,
+                               wgpu::TextureFormat format) -> wgpu::RenderPipeline {
+        using streams = wga::vertex_streams<wga::shader_type::vertex_position, wga::shader_type::vertex_surface>;
+
+        auto shader_module = pipelines.get_shader_module(
+                device, "struct vertex_input\n{\n" +
+                        wga::get_vertex_input_fields<wga::shader_type::vertex_position>() + "};\n\n" +
+                        pipelines.get_shader_source("../data/shaders/depth_only.wgsl"));
+
+        const auto layout = pipelines.get_pipeline_layout(device, {bind_group_layout.get()});
+
+        wgpu::DepthStencilState depth_stencil_state = wgpu::Default;
+        depth_stencil_state.depthCompare = wgpu::CompareFunction::Less;
+        depth_stencil_state.depthWriteEnabled = true;
+        depth_stencil_state.format = format;
+        depth_stencil_state.stencilReadMask = 0;
+        depth_stencil_state.stencilWriteMask = 0;
+
+        wgpu::RenderPipelineDescriptor desc;
+        desc.label = "Depth pipeline";
+        desc.vertex.bufferCount = 1;
+        desc.vertex.buffers = streams::buffer_layouts.data();
+        desc.vertex.module = shader_module;
+        desc.vertex.entryPoint = "vs_main";
+        desc.vertex.constantCount = 0;
+        desc.vertex.constants = nullptr;
+        desc.primitive.topology = wgpu::PrimitiveTopology::TriangleList;
+        desc.primitive.stripIndexFormat = wgpu::IndexFormat::Undefined;
+        desc.primitive.frontFace = wgpu::FrontFace::CCW;
+        desc.primitive.cullMode = wgpu::CullMode::None;
+        desc.fragment = nullptr;
+        desc.depthStencil = &depth_stencil_state;
+        desc.multisample.count = 1;
+        desc.multisample.mask = ~0u;
+        desc.multisample.alphaToCoverageEnabled = false;
+        desc.layout = layout;
+
+        return pipelines.get_render_pipeline(device, desc);
+    }
+
+    // Largest buffer a context allocates, the uniform ring, a full instance buffer or a mesh arena page
+    auto get_max_buffer_size(std::uint32_t uniforms_count) -> std::uint64_t {
+        return std::max({wga::get_uniform_ring_size(wga::max_uniform_buffer_stride, uniforms_count),
+                         std::uint64_t{wga::max_instance_count} * sizeof(wga::shader_type::instance_attributes),
+                         wga::default_mesh_vertex_page_size});
     }
 
+    // uniforms_count is the number of objects that can be drawn per frame, see wga::uniform_ring
     auto setup(wga::window_t &window, std::uint32_t width, std::uint32_t height,
-               std::uint32_t uniforms_count) -> wga::context {
+               std::uint32_t uniforms_count,
+               wgpu::PresentMode present_mode = wgpu::PresentMode::Fifo) -> wga::context {
         wga::context context{
                 wgpu::TextureFormat::Depth24Plus,
+                width,
+                height,
+                present_mode,
                 wga::create_instance(),
                 wga::create_surface(context.instance, window.get()),
-                wga::request_adapter(context.instance, context.surface),
-                wga::get_device(context.adapter),
-                wga::create_swapchain(context.surface, context.adapter, context.device, width, height),
-                wga::create_buffer(context.device, uniforms_count * get_uniform_buffer_stride(context.device),
+                wga::request_adapter(context.instance, *context.surface),
+                wga::get_swapchain_format(*context.surface, context.adapter),
+                wga::get_device(context.adapter, wga::get_max_buffer_size(uniforms_count)),
+                wga::create_swapchain(*context.surface, context.adapter, context.device, width, height, present_mode),
+                wga::create_buffer(context.device,
+                                   wga::get_uniform_ring_size(get_uniform_buffer_stride(context.device), uniforms_count),
                                    wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform),
+                wga::create_uniform_ring(context.device, uniforms_count),
                 wga::create_bind_group_layout(context.device),
-                wga::create_pipeline(context.surface, context.adapter, context.device, context.bind_group_layout,
-                                     context.depth_texture_format),
-                wga::create_queue(context.device)
+                {},
+                wga::create_pipeline(context.pipelines, context.color_format, context.device,
+                                     context.bind_group_layout, context.depth_texture_format),
+                wga::create_queue(context.device),
+                {},
+                {},
+                wga::create_mesh_arena(context.device),
+                std::nullopt
         };
 
         return context;
     }
 
+    // Context without a window or surface, frames are rendered into an owned color texture, see acquire_color_view
+    auto setup_headless(std::uint32_t width, std::uint32_t height, std::uint32_t uniforms_count) -> wga::context {
+        wga::context context{
+                wgpu::TextureFormat::Depth24Plus,
+                width,
+                height,
+                wgpu::PresentMode::Fifo,
+                wga::create_instance(),
+                std::nullopt,
+                wga::request_headless_adapter(context.instance),
+                wgpu::TextureFormat::RGBA8Unorm,
+                wga::get_device(context.adapter, wga::get_max_buffer_size(uniforms_count)),
+                std::nullopt,
+                wga::create_buffer(context.device,
+                                   wga::get_uniform_ring_size(get_uniform_buffer_stride(context.device), uniforms_count),
+                                   wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform),
+                wga::create_uniform_ring(context.device, uniforms_count),
+                wga::create_bind_group_layout(context.device),
+                {},
+                wga::create_pipeline(context.pipelines, context.color_format, context.device,
+                                     context.bind_group_layout, context.depth_texture_format),
+                wga::create_queue(context.device),
+                {},
+                {},
+                wga::create_mesh_arena(context.device),
+                std::nullopt
+        };
+
+        return context;
+    }
+
+    auto get_max_texture_dimension(wga::context &context) -> std::uint32_t {
+        wgpu::SupportedLimits supported_limits;
+        context.device.get().getLimits(&supported_limits);
+        return supported_limits.limits.maxTextureDimension2D;
+    }
+
+    // Recreates the swapchain, render targets of the old size are dropped from the pool. The size is clamped to the
+    // device's texture limit, larger framebuffers are scaled up by the surface
+    void resize(wga::context &context, std::uint32_t width, std::uint32_t height) {
+        const auto max_dimension = wga::get_max_texture_dimension(context);
+        width = std::min(width, max_dimension);
+        height = std::min(height, max_dimension);
+        if (width == context.width && height == context.height) {
+            return;
+        }
+        context.width = width;
+        context.height = height;
+        if (context.surface) {
+            context.swapchain = wga::create_swapchain(*context.surface, context.adapter, context.device, width, height,
+                                                      context.present_mode);
+        }
+        context.render_targets.clear();
+    }
+
+    // Depth attachment matching the swapchain, allocated once and reused every frame
+    auto acquire_depth_target(wga::context &context) -> wga::render_target & {
+        return context.render_targets.acquire(context.device, {context.depth_texture_format, context.width,
+                                                               context.height, 1, WGPUTextureUsage_RenderAttachment});
+    }
+
+    auto get_color_target_key(const wga::context &context) -> wga::render_target_key {
+        return {context.color_format, context.width, context.height, 1,
+                WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc};
+    }
+
+    // Owned color attachment of headless contexts, kept across frames like the depth target
+    auto acquire_color_target(wga::context &context) -> wga::render_target & {
+        return context.render_targets.acquire(context.device, wga::get_color_target_key(context));
+    }
+
+    // Color attachment of the frame, the current swapchain texture or the headless color target
+    auto acquire_color_view(wga::context &context) {
+        if (context.swapchain) {
+            return wga::object{context.swapchain->get().getCurrentTextureView()};
+        }
+
+        wgpu::TextureViewDescriptor view_desc;
+        view_desc.aspect = wgpu::TextureAspect::All;
+        view_desc.baseArrayLayer = 0;
+        view_desc.arrayLayerCount = 1;
+        view_desc.baseMipLevel = 0;
+        view_desc.mipLevelCount = 1;
+        view_desc.dimension = wgpu::TextureViewDimension::_2D;
+        view_desc.format = context.color_format;
+        return wga::object{wga::acquire_color_target(context).texture.get().createView(view_desc)};
+    }
+
+    void present(wga::context &context) {
+        if (context.swapchain) {
+            context.swapchain->get().present();
+        }
+    }
+
+    // Copies the headless color target the current frame rendered to back to the CPU, tightly packed RGBA8 rows. Call
+    // after submitting the frame and before the next render_targets.begin_frame
+    auto read_color_target(wga::context &context) -> std::vector<std::uint8_t> {
+        auto *target = context.render_targets.find(wga::get_color_target_key(context));
+        if (!target) {
+            throw std::runtime_error("No color target was rendered to in this frame");
+        }
+
+        const std::uint32_t row_size = 4 * context.width;
+        const std::uint32_t padded_row_size = (row_size + 255) / 256 * 256; // bytesPerRow must be 256 aligned
+        const std::uint64_t size = std::uint64_t{padded_row_size} * context.height;
+
+        auto readback = wga::create_buffer(context.device, size,
+                                           wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead);
+
+        wgpu::ImageCopyTexture source;
+        source.texture = target->texture.get();
+        source.mipLevel = 0;
+        source.origin = {0, 0, 0};
+        source.aspect = wgpu::TextureAspect::All;
+
+        wgpu::ImageCopyBuffer destination;
+        destination.buffer = readback.get();
+        destination.layout.offset = 0;
+        destination.layout.bytesPerRow = padded_row_size;
+        destination.layout.rowsPerImage = context.height;
+
+        wgpu::CommandEncoderDescriptor encoder_desc = {};
+        encoder_desc.label = "Readback encoder";
+        auto encoder = wga::object{context.device.get().createCommandEncoder(encoder_desc)};
+        encoder.get().copyTextureToBuffer(source, destination, {context.width, context.height, 1});
+        wgpu::CommandBufferDescriptor command_buffer_desc = {};
+        command_buffer_desc.label = "Readback command buffer";
+        auto command = wga::object{encoder.get().finish(command_buffer_desc)};
+        context.queue.get().submit(1, &command.get());
+
+        bool mapped = false;
+        auto callback = readback.get().mapAsync(wgpu::MapMode::Read, 0, static_cast<std::size_t>(size),
+                                                [&mapped](wgpu::BufferMapAsyncStatus status) {
+                                                    if (status != wgpu::BufferMapAsyncStatus::Success) {
+                                                        std::cerr << "Could not map readback buffer: " << status
+                                                                  << '\n';
+                                                    }
+                                                    mapped = true;
+                                                });
+        while (!mapped) {
+            wga::poll(context.device, true);
+        }
+
+        std::vector<std::uint8_t> pixels(std::size_t{row_size} * context.height);
+        const auto *data = static_cast<const std::uint8_t *>(
+                readback.get().getConstMappedRange(0, static_cast<std::size_t>(size)));
+        if (!data) {
+            throw std::runtime_error("Could not read color target");
+        }
+        for (std::uint32_t row = 0; row < context.height; ++row) {
+            std::memcpy(pixels.data() + std::size_t{row} * row_size, data + std::size_t{row} * padded_row_size,
+                        row_size);
+        }
+        readback.get().unmap();
+        return pixels;
+    }
+
+    void write_texture_level(wga::context &context, wga::texture &texture, std::uint32_t level,
+                             const wga::image &image, std::uint32_t layer = 0) {
+        wgpu::ImageCopyTexture destination;
+        destination.texture = texture.handle.get();
+        destination.mipLevel = level;
+        destination.origin = {0, 0, layer};
+        destination.aspect = wgpu::TextureAspect::All;
+
+        wgpu::TextureDataLayout source;
+        source.offset = 0;
+        source.bytesPerRow = 4 * image.width;
+        source.rowsPerImage = image.height;
+        context.staging_belt.write_texture(context.device, destination, image.pixels.data(), source,
+                                           {image.width, image.height, 1});
+    }
+
+    // Copies whole blocks, so the extent is the level's size rounded up to the block dimension
+    void write_texture_level(wga::context &context, wga::texture &texture, std::uint32_t level,
+                             const wga::compressed_image &image, std::uint32_t layer = 0) {
+        wgpu::ImageCopyTexture destination;
+        destination.texture = texture.handle.get();
+        destination.mipLevel = level;
+        destination.origin = {0, 0, layer};
+        destination.aspect = wgpu::TextureAspect::All;
+
+        wgpu::TextureDataLayout source;
+        source.offset = 0;
+        source.bytesPerRow = image.bytes_per_row();
+        source.rowsPerImage = image.blocks_high();
+        context.staging_belt.write_texture(context.device, destination, image.blocks.data(), source,
+                                           {image.blocks_wide() * wga::block_dimension,
+                                            image.blocks_high() * wga::block_dimension, 1});
+    }
+
+    // Uploads mip levels baked on the CPU, see wga::generate_mip_chain, no compute pass is needed
+    auto create_texture(wga::context &context, const std::vector<wga::image> &levels) -> wga::texture {
+        if (levels.empty()) {
+            std::cerr << "Cannot create a texture without mip levels\n";
+            throw std::runtime_error("Cannot create a texture without mip levels");
+        }
+
+        auto texture = wga::create_texture(context.device, levels[0].width, levels[0].height,
+                                           static_cast<std::uint32_t>(levels.size()));
+        for (std::uint32_t level = 0; level < texture.mip_level_count; ++level) {
+            wga::write_texture_level(context, texture, level, levels[level]);
+        }
+        context.staging_belt.flush(context.device, context.queue);
+        return texture;
+    }
+
+    // Uploads precompressed mip levels, see wga::compress_mip_chain. The device must support block compression and
+    // the first level's size must be a multiple of the block dimension
+    auto create_texture(wga::context &context, const std::vector<wga::compressed_image> &levels) -> wga::texture {
+        if (levels.empty()) {
+            std::cerr << "Cannot create a texture without mip levels\n";
+            throw std::runtime_error("Cannot create a texture without mip levels");
+        }
+        if (!wga::supports_block_compression(context.device)) {
+            std::cerr << "Device does not support block compressed textures\n";
+            throw std::runtime_error("Device does not support block compressed textures");
+        }
+        if (levels[0].width % wga::block_dimension != 0 || levels[0].height % wga::block_dimension != 0) {
+            std::cerr << "Compressed texture size " << levels[0].width << 'x' << levels[0].height
+                      << " is not a multiple of " << wga::block_dimension << '\n';
+            throw std::runtime_error("Compressed texture size is not a multiple of the block dimension");
+        }
+
+        auto texture = wga::create_texture(context.device, levels[0].width, levels[0].height,
+                                           static_cast<std::uint32_t>(levels.size()),
+                                           wga::get_texture_format(levels[0].format));
+        for (std::uint32_t level = 0; level < texture.mip_level_count; ++level) {
+            wga::write_texture_level(context, texture, level, levels[level]);
+        }
+        context.staging_belt.flush(context.device, context.queue);
+        return texture;
+    }
+
+    // Compresses the levels on pool when the device supports format, otherwise uploads them uncompressed
+    auto create_compressed_texture(wga::context &context, wga::thread_pool *pool,
+                                   const std::vector<wga::image> &levels, wga::block_format format) -> wga::texture {
+        if (levels.empty() || !wga::supports_block_compression(context.device) ||
+            levels[0].width % wga::block_dimension != 0 || levels[0].height % wga::block_dimension != 0) {
+            return wga::create_texture(context, levels);
+        }
+        return wga::create_texture(context, wga::compress_mip_chain(pool, levels, format));
+    }
+
+    // Uploads the image through the staging belt and fills the mip chain in the same submission
+    auto create_texture(wga::context &context, const wga::image &image, bool mipmapped = true) -> wga::texture {
+        auto texture = wga::create_texture(context.device, image.width, image.height,
+                                           mipmapped ? wga::get_mip_level_count(image.width, image.height) : 1);
+        wga::write_texture_level(context, texture, 0, image);
+
+        wgpu::CommandEncoderDescriptor encoder_desc = {};
+        encoder_desc.label = "Texture upload encoder";
+        auto encoder = wga::object{context.device.get().createCommandEncoder(encoder_desc)};
+        context.staging_belt.encode(encoder.get());
+        if (texture.mip_level_count > 1) {
+            if (!context.mipmaps) {
+                context.mipmaps.emplace(wga::create_mipmap_generator(context.device, context.pipelines));
+            }
+            context.mipmaps->generate(context.device, encoder.get(), texture);
+        }
+
+        wgpu::CommandBufferDescriptor command_buffer_desc = {};
+        command_buffer_desc.label = "Texture upload command buffer";
+        auto command = wga::object{encoder.get().finish(command_buffer_desc)};
+        context.queue.get().submit(1, &command.get());
+        context.staging_belt.recall();
+        return texture;
+    }
+
+    auto load_texture(wga::context &context, const std::filesystem::path &path) -> wga::texture {
+        auto image = wga::load_image(path);
+        const auto max_dimension = wga::get_max_texture_dimension(context);
+        if (image.width > max_dimension || image.height > max_dimension) {
+            std::cerr << "Image " << path.string() << " is " << image.width << 'x' << image.height
+                      << ", the device allows at most " << max_dimension << '\n';
+            throw std::runtime_error("Image too large for the device: " + path.string());
+        }
+        return wga::create_texture(context, image);
+    }
+
+    // Bind group of the basic pipeline sampling texture with sampler
+    auto create_bind_group(wga::context &context, wga::texture &texture, wga::object<wgpu::Sampler> &sampler) {
+        return wga::create_bind_group(context.device, context.uniform_buffer, context.bind_group_layout,
+                                      texture.view, sampler);
+    }
+
+    // Pipeline for models imported with a non default vertex format
+    auto create_pipeline(wga::context &context, const wga::vertex_format &vertex_format,
+                         const wga::shader_features &features = {}) {
+        return wga::create_pipeline(context.pipelines, context.color_format, context.device,
+                                    context.bind_group_layout, context.depth_texture_format, vertex_format, false,
+                                    features);
+    }
+
+    // Pipeline drawing a wga::instance_buffer bound to vertex buffer slot 1, see wga::draw
+    auto create_instanced_pipeline(wga::context &context,
+                                   const wga::vertex_format &vertex_format = wga::full_vertex_format,
+                                   const wga::shader_features &features = {}) {
+        return wga::create_pipeline(context.pipelines, context.color_format, context.device,
+                                    context.bind_group_layout, context.depth_texture_format, vertex_format, true,
+                                    features);
+    }
+
+    auto request_pipeline(wga::context &context, const wga::vertex_format &vertex_format,
+                          const wga::shader_features &features = {}) -> wga::render_pipeline_entry & {
+        return wga::request_pipeline(context.pipelines, context.color_format, context.device,
+                                     context.bind_group_layout, context.depth_texture_format, vertex_format, false,
+                                     features);
+    }
+
+    auto request_instanced_pipeline(wga::context &context,
+                                    const wga::vertex_format &vertex_format = wga::full_vertex_format,
+                                    const wga::shader_features &features = {}) -> wga::render_pipeline_entry & {
+        return wga::request_pipeline(context.pipelines, context.color_format, context.device,
+                                     context.bind_group_layout, context.depth_texture_format, vertex_format, true,
+                                     features);
+    }
+
 }
 
 #endif //WGA_SETUP_HPP
@@ -0,0 +1,115 @@
+#ifndef WGA_SHADER_FEATURES_HPP
+#define WGA_SHADER_FEATURES_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/vertex_format.hpp>
+
+// Shader features fixed per pipeline through WGSL override constants, so the shader compiler removes the disabled
+// paths instead of branching per fragment
+namespace wga {
+#if defined(WEBGPU_BACKEND_DAWN)
+    static constexpr bool override_constants_supported = true;
+#else
+    // wgpu-native's WGSL frontend does not parse override declarations yet, the values are baked into the source as
+    // const declarations instead, which specializes just as well but gives one shader module per permutation
+    static constexpr bool override_constants_supported = false;
+#endif
+
+    static constexpr std::uint32_t max_light_count = 4;
+
+    struct shader_features {
+        bool lighting{false};
+        bool texture{true};
+        bool vertex_color{true};
+        std::uint32_t light_count{2}; // clamped to max_light_count
+
+        [[nodiscard]] constexpr auto code() const noexcept -> std::uint32_t {
+            return static_cast<std::uint32_t>(lighting) |
+                   static_cast<std::uint32_t>(texture) << 1 |
+                   static_cast<std::uint32_t>(vertex_color) << 2 |
+                   std::min(light_count, wga::max_light_count) << 3;
+        }
+
+        auto operator==(const shader_features &other) const noexcept -> bool {
+            return code() == other.code();
+        }
+
+        auto operator!=(const shader_features &other) const noexcept -> bool {
+            return code() != other.code();
+        }
+    };
+
+    // Typed override values: the WGSL declarations to prepend to the shader and the matching constant entries
+    struct shader_constants {
+        std::string declarations;
+        std::vector<WGPUConstantEntry> entries; // empty unless override_constants_supported
+
+        // name must outlive the pipeline descriptor the entries are passed to, e.g. a string literal
+        void add(const char *name, const char *type, const std::string &literal, double value) {
+            if constexpr (wga::override_constants_supported) {
+                declarations += std::string("override ") + name + ": " + type + ";\n";
+                entries.push_back({nullptr, name, value});
+            } else {
+                declarations += std::string("const ") + name + ": " + type + " = " + literal + ";\n";
+            }
+        }
+
+        void add(const char *name, bool value) {
+            add(name, "bool", value ? "true" : "false", value ? 1.0 : 0.0);
+        }
+
+        void add(const char *name, std::uint32_t value) {
+            add(name, "u32", std::to_string(value) + "u", static_cast<double>(value));
+        }
+
+        // Printed with enough digits to round trip, std::to_string would print 1e-7 as 0.000000
+        void add(const char *name, float value) {
+            char literal[32];
+            std::snprintf(literal, sizeof(literal), "%.9g", static_cast<double>(value));
+            add(name, "f32", literal, static_cast<double>(value));
+        }
+    };
+
+    // Overrides read by basic_color.wgsl
+    auto get_shader_constants(const wga::shader_features &features) -> wga::shader_constants {
+        wga::shader_constants constants;
+        constants.add("use_lighting", features.lighting);
+        constants.add("use_texture", features.texture);
+        constants.add("use_vertex_color", features.vertex_color);
+        constants.add("light_count", std::min(features.light_count, wga::max_light_count));
+        return constants;
+    }
+
+    // The permutation key has 8 bits for the features and for each texture format
+    static_assert(wga::shader_features{true, true, true, wga::max_light_count}.code() <= 0xff,
+                  "Shader features no longer fit the permutation key");
+    static_assert(WGPUTextureFormat_ASTC12x12UnormSrgb <= 0xff,
+                  "Texture formats no longer fit the permutation key");
+
+    // Everything the basic pipeline varies by besides the context's bind group layout, see wga::create_pipeline
+    auto get_permutation_key(wgpu::TextureFormat color_format, wgpu::TextureFormat depth_format,
+                             const wga::vertex_format &vertex_format, bool instanced,
+                             const wga::shader_features &features) -> std::uint64_t {
+        const std::uint64_t color = static_cast<WGPUTextureFormat>(color_format);
+        const std::uint64_t depth = static_cast<WGPUTextureFormat>(depth_format);
+        // Extension formats of a backend lie outside the standard range
+        if (color > 0xff || depth > 0xff) {
+            throw std::runtime_error("Texture format does not fit the pipeline permutation key");
+        }
+        return std::uint64_t{vertex_format.code()} |
+               std::uint64_t{features.code()} << 32 |
+               std::uint64_t{instanced} << 40 |
+               color << 48 |
+               depth << 56;
+    }
+}
+
+#endif //WGA_SHADER_FEATURES_HPP
@@ -5,8 +5,13 @@
 #ifndef WGA_SHADER_TYPES_HPP
 #define WGA_SHADER_TYPES_HPP
 
+#include <cstddef>
+#include <cstdint>
+
 #include <glm/glm.hpp>
 
+#include <wga/vertex_layout.hpp>
+
 namespace wga::shader_type
 {
     struct uniforms {
@@ -15,7 +20,11 @@ namespace wga::shader_type
         glm::mat4x4 model_matrix;
         glm::vec4 color;
         float time{};
-        [[maybe_unused]] float padding[3]{};
+        std::uint32_t texture_layer{}; // layer of the material texture array, see wga::material_textures
+        [[maybe_unused]] float padding[2]{};
+        // Dequantization of wga::position_format::unorm16x4 positions, position = offset + q * scale
+        glm::vec4 position_offset{0.0f};
+        glm::vec4 position_scale{1.0f};
     };
 
     struct vertex_attributes{
@@ -24,6 +33,69 @@ namespace wga::shader_type
         glm::vec3 color;
         glm::vec2 uv;
     };
+
+    // vertex_attributes split into two streams, depth only passes bind just the 12 byte position stream
+    struct vertex_position {
+        glm::vec3 position;
+    };
+
+    struct vertex_surface {
+        glm::vec3 normal;
+        glm::vec3 color;
+        glm::vec2 uv;
+    };
+
+    // Per instance stream of instanced draws, replaces uniforms::model_matrix and uniforms::texture_layer and
+    // tints the vertex color
+    struct instance_attributes {
+        glm::mat4x4 model_matrix;
+        glm::vec4 color;
+        std::uint32_t texture_layer{};
+    };
 }
 
+template<>
+struct wga::vertex_description<wga::shader_type::vertex_attributes> {
+    using vertex = wga::shader_type::vertex_attributes;
+    static constexpr std::array attributes{
+            WGA_VERTEX_ATTRIBUTE(vertex, position, 0),
+            WGA_VERTEX_ATTRIBUTE(vertex, normal, 1),
+            WGA_VERTEX_ATTRIBUTE(vertex, color, 2),
+            WGA_VERTEX_ATTRIBUTE(vertex, uv, 3)};
+};
+
+template<>
+struct wga::vertex_description<wga::shader_type::vertex_position> {
+    using vertex = wga::shader_type::vertex_position;
+    static constexpr std::array attributes{
+            WGA_VERTEX_ATTRIBUTE(vertex, position, 0)};
+};
+
+template<>
+struct wga::vertex_description<wga::shader_type::vertex_surface> {
+    using vertex = wga::shader_type::vertex_surface;
+    static constexpr std::array attributes{
+            WGA_VERTEX_ATTRIBUTE(vertex, normal, 1),
+            WGA_VERTEX_ATTRIBUTE(vertex, color, 2),
+            WGA_VERTEX_ATTRIBUTE(vertex, uv, 3)};
+};
+
+// A mat4x4 is passed as four vec4 column attributes
+template<>
+struct wga::vertex_description<wga::shader_type::instance_attributes> {
+    using instance = wga::shader_type::instance_attributes;
+    static constexpr std::size_t column_size = sizeof(glm::vec4);
+    static constexpr std::array attributes{
+            wga::vertex_attribute_info{"model_matrix_0", WGPUVertexFormat_Float32x4,
+                                       offsetof(instance, model_matrix) + 0 * column_size, 4, column_size},
+            wga::vertex_attribute_info{"model_matrix_1", WGPUVertexFormat_Float32x4,
+                                       offsetof(instance, model_matrix) + 1 * column_size, 5, column_size},
+            wga::vertex_attribute_info{"model_matrix_2", WGPUVertexFormat_Float32x4,
+                                       offsetof(instance, model_matrix) + 2 * column_size, 6, column_size},
+            wga::vertex_attribute_info{"model_matrix_3", WGPUVertexFormat_Float32x4,
+                                       offsetof(instance, model_matrix) + 3 * column_size, 7, column_size},
+            WGA_VERTEX_ATTRIBUTE(instance, color, 8),
+            WGA_VERTEX_ATTRIBUTE(instance, texture_layer, 9)};
+};
+
 #endif //WGA_SHADER_TYPES_HPP
@@ -0,0 +1,245 @@
+#ifndef WGA_STAGING_BELT_HPP
+#define WGA_STAGING_BELT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+
+// Uploads written into mapped MapWrite | CopySrc buffers and copied on the GPU timeline,
+// instead of going through queue.writeBuffer/writeTexture one call at a time
+namespace wga {
+    // copyBufferToBuffer needs 4 byte aligned offsets and sizes, copyBufferToTexture 256 byte aligned rows
+    static constexpr std::uint64_t staging_buffer_alignment = 4;
+    static constexpr std::uint64_t staging_texture_alignment = 256;
+
+    static constexpr std::uint64_t default_staging_chunk_size = 1 << 20;
+
+    enum class staging_chunk_state {
+        mapped,  // writable, the CPU owns it
+        pending, // unmapped and waiting for the GPU to finish the copies that read it
+        failed
+    };
+
+    struct staging_chunk {
+        // Declared first so the buffer is released before the callback it may still call
+        std::unique_ptr<wgpu::BufferMapCallback> map_callback;
+        wga::object<wgpu::Buffer, true> buffer;
+        std::uint64_t size;
+        std::uint64_t offset;
+        std::byte *mapped;
+        std::shared_ptr<wga::staging_chunk_state> state; // shared with map_callback
+    };
+
+    auto create_staging_chunk(wga::object<wgpu::Device> &device, std::uint64_t size)
+    -> std::unique_ptr<wga::staging_chunk> {
+        auto buffer = wga::create_buffer(device, size, wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc, true);
+        auto *mapped = static_cast<std::byte *>(buffer.get().getMappedRange(0, static_cast<std::size_t>(size)));
+        if (!mapped) {
+            std::cerr << "Could not map a staging buffer of " << size << " bytes\n";
+            throw std::runtime_error("Could not map staging buffer");
+        }
+        return std::make_unique<wga::staging_chunk>(wga::staging_chunk{
+                nullptr, std::move(buffer), size, 0, mapped,
+                std::make_shared<wga::staging_chunk_state>(wga::staging_chunk_state::mapped)});
+    }
+
+    struct staging_buffer_copy {
+        wgpu::Buffer source;
+        std::uint64_t source_offset;
+        wgpu::Buffer destination;
+        std::uint64_t destination_offset;
+        std::uint64_t size;
+    };
+
+    struct staging_texture_copy {
+        wgpu::ImageCopyBuffer source;
+        wgpu::ImageCopyTexture destination;
+        wgpu::Extent3D size;
+    };
+
+    // Chunks cycle through active (written this frame), in flight (submitted, mapAsync pending) and free (mapped
+    // again), new chunks are only created when none has come back yet, so uploads never wait on the queue.
+    // Per frame: write_buffer/write_texture, encode into the frame's encoder before anything reads the targets,
+    // submit, then recall.
+    struct staging_belt {
+        std::uint64_t chunk_size{wga::default_staging_chunk_size};
+
+        std::vector<std::unique_ptr<wga::staging_chunk>> active;
+        std::vector<std::unique_ptr<wga::staging_chunk>> in_flight;
+        std::vector<std::unique_ptr<wga::staging_chunk>> free;
+
+        std::vector<wga::staging_buffer_copy> buffer_copies;
+        std::vector<wga::staging_texture_copy> texture_copies;
+
+        std::uint64_t uploaded_bytes{0}; // since creation, for throughput statistics
+
+        // Returns the chunk and offset of size bytes of mapped staging memory
+        auto allocate(wga::object<wgpu::Device> &device, std::uint64_t size, std::uint64_t alignment)
+        -> std::pair<wga::staging_chunk *, std::uint64_t> {
+            for (auto &chunk: active) {
+                const auto offset = (chunk->offset + alignment - 1) / alignment * alignment;
+                if (offset + size <= chunk->size) {
+                    chunk->offset = offset + size;
+                    return {chunk.get(), offset};
+                }
+            }
+
+            reclaim();
+            if (free.empty()) {
+                // Map callbacks only run while the device is polled
+                wga::poll(device, false);
+                reclaim();
+            }
+
+            auto reusable = std::find_if(free.begin(), free.end(), [size](const auto &chunk) {
+                return chunk->size >= size;
+            });
+            if (reusable != free.end()) {
+                active.push_back(std::move(*reusable));
+                free.erase(reusable);
+            } else {
+                active.push_back(wga::create_staging_chunk(device, std::max(chunk_size, size)));
+            }
+            active.back()->offset = size;
+            return {active.back().get(), 0};
+        }
+
+        // Copies data into staging memory now, the copy into destination is recorded by encode.
+        // Buffer sizes are multiples of 4 in WebGPU, size is rounded up and the padding is zeroed
+        void write_buffer(wga::object<wgpu::Device> &device, const wgpu::Buffer &destination,
+                          std::uint64_t destination_offset, const void *data, std::uint64_t size) {
+            if (size == 0) {
+                return;
+            }
+            const auto copy_size = (size + wga::staging_buffer_alignment - 1) / wga::staging_buffer_alignment *
+                                   wga::staging_buffer_alignment;
+            const auto [chunk, offset] = allocate(device, copy_size, wga::staging_buffer_alignment);
+            std::memcpy(chunk->mapped + offset, data, static_cast<std::size_t>(size));
+            std::memset(chunk->mapped + offset + size, 0, static_cast<std::size_t>(copy_size - size));
+
+            buffer_copies.push_back({chunk->buffer.get(), offset, destination, destination_offset, copy_size});
+            uploaded_bytes += copy_size;
+        }
+
+        // Same arguments as queue.writeTexture, rows are repacked to the 256 byte pitch copyBufferToTexture needs
+        void write_texture(wga::object<wgpu::Device> &device, const wgpu::ImageCopyTexture &destination,
+                           const void *data, const wgpu::TextureDataLayout &data_layout, const wgpu::Extent3D &size) {
+            const std::uint64_t row_size = data_layout.bytesPerRow;
+            const std::uint64_t row_count = std::uint64_t{data_layout.rowsPerImage} * size.depthOrArrayLayers;
+            if (row_size == 0 || row_count == 0) {
+                return;
+            }
+            const auto pitch = (row_size + wga::staging_texture_alignment - 1) / wga::staging_texture_alignment *
+                               wga::staging_texture_alignment;
+            const auto [chunk, offset] = allocate(device, pitch * row_count, wga::staging_texture_alignment);
+
+            const auto *source_rows = static_cast<const std::byte *>(data) + data_layout.offset;
+            for (std::uint64_t row = 0; row < row_count; ++row) {
+                std::memcpy(chunk->mapped + offset + row * pitch, source_rows + row * row_size,
+                            static_cast<std::size_t>(row_size));
+            }
+
+            wgpu::ImageCopyBuffer source;
+            source.buffer = chunk->buffer.get();
+            source.layout.offset = offset;
+            source.layout.bytesPerRow = static_cast<std::uint32_t>(pitch);
+            source.layout.rowsPerImage = data_layout.rowsPerImage;
+            texture_copies.push_back({source, destination, size});
+            uploaded_bytes += pitch * row_count;
+        }
+
+        [[nodiscard]] auto empty() const noexcept -> bool {
+            return buffer_copies.empty() && texture_copies.empty();
+        }
+
+        // Records every pending copy into encoder and unmaps the chunks they read, submit before calling recall
+        void encode(wgpu::CommandEncoder &encoder) {
+            for (const auto &copy: buffer_copies) {
+                encoder.copyBufferToBuffer(copy.source, copy.source_offset, copy.destination, copy.destination_offset,
+                                           copy.size);
+            }
+            for (const auto &copy: texture_copies) {
+                encoder.copyBufferToTexture(copy.source, copy.destination, copy.size);
+            }
+            buffer_copies.clear();
+            texture_copies.clear();
+
+            for (auto &chunk: active) {
+                chunk->buffer.get().unmap();
+                chunk->mapped = nullptr;
+                *chunk->state = wga::staging_chunk_state::pending;
+                in_flight.push_back(std::move(chunk));
+            }
+            active.clear();
+        }
+
+        // Maps the submitted chunks again, they become free once the GPU is done with them
+        void recall() {
+            for (auto &chunk: in_flight) {
+                if (chunk->map_callback) {
+                    continue;
+                }
+                chunk->map_callback = chunk->buffer.get().mapAsync(
+                        wgpu::MapMode::Write, 0, static_cast<std::size_t>(chunk->size),
+                        [state = chunk->state](wgpu::BufferMapAsyncStatus status) {
+                            if (status != wgpu::BufferMapAsyncStatus::Success) {
+                                std::cerr << "Could not map staging buffer: " << status << '\n';
+                                *state = wga::staging_chunk_state::failed;
+                                return;
+                            }
+                            *state = wga::staging_chunk_state::mapped;
+                        });
+            }
+        }
+
+        // Moves chunks whose mapAsync completed to the free list, chunks that failed to map are dropped
+        void reclaim() {
+            for (auto &chunk: in_flight) {
+                if (!chunk->map_callback || *chunk->state == wga::staging_chunk_state::pending) {
+                    continue;
+                }
+                chunk->map_callback.reset();
+                if (*chunk->state == wga::staging_chunk_state::mapped) {
+                    chunk->mapped = static_cast<std::byte *>(
+                            chunk->buffer.get().getMappedRange(0, static_cast<std::size_t>(chunk->size)));
+                    chunk->offset = 0;
+                    if (chunk->mapped) {
+                        free.push_back(std::move(chunk));
+                    }
+                }
+                chunk.reset();
+            }
+            in_flight.erase(std::remove(in_flight.begin(), in_flight.end(), nullptr), in_flight.end());
+        }
+
+        // Encodes the pending copies into their own command buffer and submits it, for uploads outside of a frame
+        void flush(wga::object<wgpu::Device> &device, wga::object<wgpu::Queue> &queue) {
+            if (empty()) {
+                return;
+            }
+
+            wgpu::CommandEncoderDescriptor encoder_desc = {};
+            encoder_desc.label = "Staging belt encoder";
+            auto encoder = wga::object{device.get().createCommandEncoder(encoder_desc)};
+            encode(encoder.get());
+
+            wgpu::CommandBufferDescriptor command_buffer_desc = {};
+            command_buffer_desc.label = "Staging belt command buffer";
+            auto command = wga::object{encoder.get().finish(command_buffer_desc)};
+            queue.get().submit(1, &command.get());
+            recall();
+        }
+    };
+}
+
+#endif //WGA_STAGING_BELT_HPP
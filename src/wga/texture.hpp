@@ -0,0 +1,207 @@
+#ifndef WGA_TEXTURE_HPP
+#define WGA_TEXTURE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+#include <wga/block_compression.hpp>
+#include <wga/image.hpp>
+#include <wga/pipeline_cache.hpp>
+
+// Sampled 2D textures and texture arrays with full mip chains, generated on the device by a compute downsample pass
+namespace wga {
+    static constexpr wgpu::TextureFormat texture_format = wgpu::TextureFormat::RGBA8Unorm;
+    static constexpr std::uint32_t mipmap_workgroup_size = 8;
+
+    // Down to 1x1
+    constexpr auto get_mip_level_count(std::uint32_t width, std::uint32_t height) -> std::uint32_t {
+        std::uint32_t count = 1;
+        for (auto size = std::max(width, height); size > 1; size /= 2) {
+            ++count;
+        }
+        return count;
+    }
+
+    constexpr auto get_texture_format(wga::block_format format) -> wgpu::TextureFormat {
+        switch (format) {
+            case wga::block_format::bc1:
+                return wgpu::TextureFormat::BC1RGBAUnorm;
+            case wga::block_format::bc3:
+                return wgpu::TextureFormat::BC3RGBAUnorm;
+            case wga::block_format::bc5:
+                return wgpu::TextureFormat::BC5RGUnorm;
+            case wga::block_format::bc7:
+                return wgpu::TextureFormat::BC7RGBAUnorm;
+        }
+        return wga::texture_format;
+    }
+
+    struct texture {
+        wga::object<wgpu::Texture, true> handle;
+        wga::object<wgpu::TextureView> view; // all mip levels and layers as a 2D array
+        wgpu::Extent3D size; // depthOrArrayLayers is the layer count
+        std::uint32_t mip_level_count;
+        wgpu::TextureFormat format{wga::texture_format};
+    };
+
+    auto create_texture_view(wgpu::Texture texture, std::uint32_t base_mip_level, std::uint32_t mip_level_count,
+                             wgpu::TextureFormat format = wga::texture_format,
+                             wgpu::TextureViewDimension dimension = wgpu::TextureViewDimension::_2D,
+                             std::uint32_t base_array_layer = 0, std::uint32_t array_layer_count = 1) {
+        wgpu::TextureViewDescriptor desc;
+        desc.label = "Texture view";
+        desc.aspect = wgpu::TextureAspect::All;
+        desc.baseArrayLayer = base_array_layer;
+        desc.arrayLayerCount = array_layer_count;
+        desc.baseMipLevel = base_mip_level;
+        desc.mipLevelCount = mip_level_count;
+        desc.dimension = dimension;
+        desc.format = format;
+        return wga::object{texture.createView(desc)};
+    }
+
+    // Storage binding lets the mipmap generator write the levels below the first, block compressed formats can't be
+    // storage textures and need every level uploaded. The view is a 2D array even for a single layer, so any texture
+    // fits the basic pipeline's texture_2d_array binding
+    auto create_texture(wga::object<wgpu::Device> &device, std::uint32_t width, std::uint32_t height,
+                        std::uint32_t mip_level_count, wgpu::TextureFormat format = wga::texture_format,
+                        std::uint32_t layer_count = 1) -> wga::texture {
+        const bool storage = mip_level_count > 1 && format == wga::texture_format;
+        wgpu::TextureDescriptor desc;
+        desc.label = "Texture";
+        desc.dimension = wgpu::TextureDimension::_2D;
+        desc.format = format;
+        desc.mipLevelCount = mip_level_count;
+        desc.sampleCount = 1;
+        desc.size = {width, height, layer_count};
+        desc.usage = wgpu::TextureUsage::CopyDst | wgpu::TextureUsage::TextureBinding |
+                     (storage ? wgpu::TextureUsage::StorageBinding : wgpu::TextureUsage::None);
+        desc.viewFormatCount = 0;
+        desc.viewFormats = nullptr;
+        auto handle = wga::object<wgpu::Texture, true>{device.get().createTexture(desc)};
+        auto view = wga::create_texture_view(handle.get(), 0, mip_level_count, format,
+                                             wgpu::TextureViewDimension::_2DArray, 0, layer_count);
+        return {std::move(handle), std::move(view), desc.size, mip_level_count, format};
+    }
+
+    // Requires the TextureCompressionBC feature, which wga::get_device requests whenever the adapter has it
+    auto supports_block_compression(wga::object<wgpu::Device> &device) -> bool {
+        return device.get().hasFeature(wgpu::FeatureName::TextureCompressionBC);
+    }
+
+    // Trilinear filtering, anisotropic up to max_anisotropy
+    auto create_sampler(wga::object<wgpu::Device> &device, std::uint32_t mip_level_count,
+                        std::uint16_t max_anisotropy = 8) {
+        wgpu::SamplerDescriptor desc;
+        desc.label = "Sampler";
+        desc.addressModeU = wgpu::AddressMode::Repeat;
+        desc.addressModeV = wgpu::AddressMode::Repeat;
+        desc.addressModeW = wgpu::AddressMode::ClampToEdge;
+        desc.magFilter = wgpu::FilterMode::Linear;
+        desc.minFilter = wgpu::FilterMode::Linear;
+        desc.mipmapFilter = wgpu::MipmapFilterMode::Linear;
+        desc.lodMinClamp = 0.0f;
+        desc.lodMaxClamp = static_cast<float>(mip_level_count);
+        desc.compare = wgpu::CompareFunction::Undefined;
+        desc.maxAnisotropy = max_anisotropy;
+        return wga::object{device.get().createSampler(desc)};
+    }
+
+    struct mipmap_generator {
+        wga::object<wgpu::BindGroupLayout> bind_group_layout;
+        wga::object<wgpu::ComputePipeline> pipeline;
+
+        // Records one dispatch per level of layers [first_layer, first_layer + layer_count) into encoder, level 0
+        // must be written before the encoder is submitted
+        void generate(wga::object<wgpu::Device> &device, wgpu::CommandEncoder encoder, const wga::texture &texture,
+                      std::uint32_t first_layer = 0, std::uint32_t layer_count = 1) {
+            if (texture.mip_level_count <= 1 || texture.format != wga::texture_format) {
+                return;
+            }
+
+            // Views and bind groups only need to live until the pass is recorded
+            std::vector<wga::object<wgpu::TextureView>> views;
+            std::vector<wga::object<wgpu::BindGroup>> bind_groups;
+            views.reserve(std::size_t{texture.mip_level_count} * layer_count);
+            for (auto layer = first_layer; layer < first_layer + layer_count; ++layer) {
+                for (std::uint32_t level = 0; level < texture.mip_level_count; ++level) {
+                    views.push_back(wga::create_texture_view(texture.handle.get(), level, 1, texture.format,
+                                                             wgpu::TextureViewDimension::_2D, layer, 1));
+                }
+            }
+
+            wgpu::ComputePassDescriptor pass_desc;
+            pass_desc.label = "Mipmap pass";
+            pass_desc.timestampWriteCount = 0;
+            pass_desc.timestampWrites = nullptr;
+            auto pass = wga::object{encoder.beginComputePass(pass_desc)};
+            pass.get().setPipeline(pipeline.get());
+
+            for (std::uint32_t layer = 0; layer < layer_count; ++layer) {
+                const auto *layer_views = views.data() + std::size_t{layer} * texture.mip_level_count;
+                for (std::uint32_t level = 1; level < texture.mip_level_count; ++level) {
+                    std::vector<wgpu::BindGroupEntry> bindings(2);
+                    bindings[0].binding = 0;
+                    bindings[0].textureView = layer_views[level - 1].get();
+                    bindings[1].binding = 1;
+                    bindings[1].textureView = layer_views[level].get();
+
+                    wgpu::BindGroupDescriptor bind_group_desc{};
+                    bind_group_desc.label = "Mipmap bind group";
+                    bind_group_desc.layout = bind_group_layout.get();
+                    bind_group_desc.entryCount = static_cast<std::uint32_t>(bindings.size());
+                    bind_group_desc.entries = bindings.data();
+                    bind_groups.push_back(wga::object{device.get().createBindGroup(bind_group_desc)});
+
+                    const auto width = std::max(texture.size.width >> level, 1u);
+                    const auto height = std::max(texture.size.height >> level, 1u);
+                    pass.get().setBindGroup(0, bind_groups.back().get(), 0, nullptr);
+                    pass.get().dispatchWorkgroups(
+                            (width + wga::mipmap_workgroup_size - 1) / wga::mipmap_workgroup_size,
+                            (height + wga::mipmap_workgroup_size - 1) / wga::mipmap_workgroup_size, 1);
+                }
+            }
+            pass.get().end();
+        }
+    };
+
+    auto create_mipmap_generator(wga::object<wgpu::Device> &device, wga::pipeline_cache &pipelines)
+    -> wga::mipmap_generator {
+        std::vector<wgpu::BindGroupLayoutEntry> entries(2, wgpu::Default);
+        entries[0].binding = 0;
+        entries[0].visibility = wgpu::ShaderStage::Compute;
+        entries[0].texture.sampleType = wgpu::TextureSampleType::Float;
+        entries[0].texture.viewDimension = wgpu::TextureViewDimension::_2D;
+
+        entries[1].binding = 1;
+        entries[1].visibility = wgpu::ShaderStage::Compute;
+        entries[1].storageTexture.access = wgpu::StorageTextureAccess::WriteOnly;
+        entries[1].storageTexture.format = wga::texture_format;
+        entries[1].storageTexture.viewDimension = wgpu::TextureViewDimension::_2D;
+
+        wgpu::BindGroupLayoutDescriptor bind_group_layout_desc{};
+        bind_group_layout_desc.label = "Mipmap bind group layout";
+        bind_group_layout_desc.entryCount = static_cast<std::uint32_t>(entries.size());
+        bind_group_layout_desc.entries = entries.data();
+        auto bind_group_layout = wga::object{device.get().createBindGroupLayout(bind_group_layout_desc)};
+
+        wgpu::ComputePipelineDescriptor desc;
+        desc.label = "Mipmap pipeline";
+        desc.layout = pipelines.get_pipeline_layout(device, {bind_group_layout.get()});
+        desc.compute.module = pipelines.get_shader_module(
+                device, pipelines.get_shader_source("../data/shaders/mipmap.wgsl"));
+        desc.compute.entryPoint = "downsample";
+        desc.compute.constantCount = 0;
+        desc.compute.constants = nullptr;
+        auto pipeline = wga::object{device.get().createComputePipeline(desc)};
+        return {std::move(bind_group_layout), std::move(pipeline)};
+    }
+}
+
+#endif //WGA_TEXTURE_HPP
@@ -0,0 +1,89 @@
+#ifndef WGA_THREAD_POOL_HPP
+#define WGA_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed set of worker threads running tasks in submission order, for CPU work that must stay off the render thread
+namespace wga {
+    // Leaves one hardware thread to the render thread
+    auto get_default_thread_count() -> std::size_t {
+        return std::max<std::size_t>(std::thread::hardware_concurrency(), 2) - 1;
+    }
+
+    struct thread_pool {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::function<void()>> tasks;
+        bool stopping{false};
+        std::vector<std::thread> threads;
+
+        explicit thread_pool(std::size_t thread_count = wga::get_default_thread_count()) {
+            threads.reserve(thread_count);
+            for (std::size_t i = 0; i < thread_count; ++i) {
+                threads.emplace_back([this] { run(); });
+            }
+        }
+
+        // Tasks that have not started are dropped, their futures report std::future_errc::broken_promise
+        ~thread_pool() {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+                tasks.clear();
+            }
+            condition.notify_all();
+            for (auto &thread: threads) {
+                thread.join();
+            }
+        }
+
+        thread_pool(const thread_pool &) = delete;
+        thread_pool(thread_pool &&) = delete;
+        auto operator=(const thread_pool &) -> thread_pool & = delete;
+        auto operator=(thread_pool &&) -> thread_pool & = delete;
+
+        // Exceptions thrown by task are rethrown by the future's get
+        template<typename F>
+        auto submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+            // std::function needs a copyable target, the packaged_task is shared instead
+            auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<std::decay_t<F>>()>>(
+                    std::forward<F>(task));
+            auto future = packaged->get_future();
+            {
+                std::lock_guard lock(mutex);
+                tasks.emplace_back([packaged] { (*packaged)(); });
+            }
+            condition.notify_one();
+            return future;
+        }
+
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if (stopping) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+}
+
+#endif //WGA_THREAD_POOL_HPP
@@ -9,13 +9,18 @@
 
 namespace wga {
     template<typename T>
-    auto type_name(const T &) -> const char * {
+    auto type_name() -> const char * {
 #if defined(__GXX_RTTI) || defined(__CPPRTTI) || defined(_MSC_VER)
         return typeid(T).name();
 #else
         return "(no rtti)";
 #endif
     }
+
+    template<typename T>
+    auto type_name(const T &) -> const char * {
+        return wga::type_name<T>();
+    }
 }
 
 #endif //WGA_TYPE_INFO_HPP
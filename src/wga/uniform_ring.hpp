@@ -0,0 +1,90 @@
+#ifndef WGA_UNIFORM_RING_HPP
+#define WGA_UNIFORM_RING_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+
+#include <wga/wga.hpp>
+#include <wga/staging_belt.hpp>
+
+namespace wga {
+    // Number of frames the uniform buffer is split into, the CPU writes one while the GPU may still read the others
+    static constexpr std::uint32_t uniform_ring_frames = 3;
+
+    // WebGPU caps minUniformBufferOffsetAlignment at 256, so no device needs a larger stride for wga::shader_type::uniforms
+    static constexpr std::uint64_t max_uniform_buffer_stride = 256;
+
+    // Per frame uniform blocks of many objects, packed at the dynamic offset stride in a CPU array
+    // and staged as a single copy, every draw then binds its block with its own dynamic offset
+    struct uniform_ring {
+        std::uint32_t stride;
+        std::uint32_t capacity; // blocks per frame
+        std::uint32_t frame{0};
+        std::uint32_t count{0};
+        std::vector<std::byte> staging;
+
+        // Set by onSubmittedWorkDone once the GPU finished the frame that last used the region
+        std::array<std::shared_ptr<bool>, uniform_ring_frames> frame_done;
+        std::array<std::unique_ptr<wgpu::QueueWorkDoneCallback>, uniform_ring_frames> frame_callbacks;
+
+        [[nodiscard]] auto frame_offset() const noexcept -> std::uint32_t {
+            return frame * capacity * stride;
+        }
+
+        // Moves to the next region, waiting for the GPU only if it is still reading it from three frames ago
+        void begin_frame(wga::object<wgpu::Device> &device) {
+            frame = (frame + 1) % uniform_ring_frames;
+            count = 0;
+
+            const auto &done = frame_done[frame];
+            while (done && !*done) {
+                wga::poll(device, true);
+            }
+            frame_callbacks[frame].reset();
+        }
+
+        // Copies the block into the staging array and returns the dynamic offset to bind it with
+        auto push(const wga::shader_type::uniforms &uniforms) -> std::uint32_t {
+            if (count == capacity) {
+                std::cerr << "Uniform ring is full, it holds " << capacity << " blocks per frame\n";
+                throw std::runtime_error("Uniform ring is full");
+            }
+
+            std::memcpy(staging.data() + std::size_t{count} * stride, &uniforms, sizeof(uniforms));
+            return frame_offset() + count++ * stride;
+        }
+
+        void upload(wga::object<wgpu::Device> &device, wga::staging_belt &staging_belt,
+                    wga::object<wgpu::Buffer, true> &buffer) const {
+            staging_belt.write_buffer(device, buffer.get(), frame_offset(), staging.data(), std::uint64_t{count} * stride);
+        }
+
+        // Call after submitting the frame's command buffers
+        void end_frame(wga::object<wgpu::Queue> &queue) {
+            auto done = std::make_shared<bool>(false);
+            frame_done[frame] = done;
+            frame_callbacks[frame] = queue.get().onSubmittedWorkDone([done](wgpu::QueueWorkDoneStatus) {
+                *done = true;
+            });
+        }
+    };
+
+    auto create_uniform_ring(wga::object<wgpu::Device> &device, std::uint32_t capacity) -> wga::uniform_ring {
+        const auto stride = wga::get_uniform_buffer_stride(device);
+        return wga::uniform_ring{stride, capacity, 0, 0, std::vector<std::byte>(std::size_t{capacity} * stride), {}, {}};
+    }
+
+    auto get_uniform_ring_size(std::uint32_t stride, std::uint32_t capacity) -> std::uint64_t {
+        return std::uint64_t{uniform_ring_frames} * capacity * stride;
+    }
+}
+
+#endif //WGA_UNIFORM_RING_HPP
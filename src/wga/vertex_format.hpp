@@ -0,0 +1,269 @@
+#ifndef WGA_VERTEX_FORMAT_HPP
+#define WGA_VERTEX_FORMAT_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <webgpu/webgpu.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <wga/shader_types.hpp>
+#include <wga/vertex_layout.hpp>
+
+// Per model vertex layouts, from full float attributes down to a 20 byte quantized vertex
+namespace wga {
+    enum class position_format : std::uint8_t {
+        float32x3,
+        unorm16x4, // quantized relative to the mesh bounds, w is unused
+    };
+
+    enum class normal_format : std::uint8_t {
+        float32x3,
+        octahedral_snorm16x2,
+    };
+
+    enum class color_format : std::uint8_t {
+        float32x3,
+        unorm8x4,
+    };
+
+    enum class uv_format : std::uint8_t {
+        float32x2,
+        float16x2,
+        unorm16x2, // only for uvs within [0, 1]
+    };
+
+    struct vertex_format {
+        wga::position_format position{wga::position_format::float32x3};
+        wga::normal_format normal{wga::normal_format::float32x3};
+        wga::color_format color{wga::color_format::float32x3};
+        wga::uv_format uv{wga::uv_format::float32x2};
+
+        [[nodiscard]] auto code() const noexcept -> std::uint32_t {
+            return static_cast<std::uint32_t>(position) |
+                   static_cast<std::uint32_t>(normal) << 8 |
+                   static_cast<std::uint32_t>(color) << 16 |
+                   static_cast<std::uint32_t>(uv) << 24;
+        }
+
+        auto operator==(const vertex_format &other) const noexcept -> bool {
+            return code() == other.code();
+        }
+
+        auto operator!=(const vertex_format &other) const noexcept -> bool {
+            return code() != other.code();
+        }
+    };
+
+    static constexpr wga::vertex_format full_vertex_format{};
+
+    static constexpr wga::vertex_format compact_vertex_format{
+            wga::position_format::unorm16x4,
+            wga::normal_format::octahedral_snorm16x2,
+            wga::color_format::unorm8x4,
+            wga::uv_format::float16x2};
+
+    constexpr auto get_wgpu_vertex_format(wga::position_format format) -> wgpu::VertexFormat {
+        return format == wga::position_format::unorm16x4 ? wgpu::VertexFormat::Unorm16x4
+                                                         : wgpu::VertexFormat::Float32x3;
+    }
+
+    constexpr auto get_wgpu_vertex_format(wga::normal_format format) -> wgpu::VertexFormat {
+        return format == wga::normal_format::octahedral_snorm16x2 ? wgpu::VertexFormat::Snorm16x2
+                                                                  : wgpu::VertexFormat::Float32x3;
+    }
+
+    constexpr auto get_wgpu_vertex_format(wga::color_format format) -> wgpu::VertexFormat {
+        return format == wga::color_format::unorm8x4 ? wgpu::VertexFormat::Unorm8x4
+                                                     : wgpu::VertexFormat::Float32x3;
+    }
+
+    constexpr auto get_wgpu_vertex_format(wga::uv_format format) -> wgpu::VertexFormat {
+        switch (format) {
+            case wga::uv_format::float16x2:
+                return wgpu::VertexFormat::Float16x2;
+            case wga::uv_format::unorm16x2:
+                return wgpu::VertexFormat::Unorm16x2;
+            default:
+                return wgpu::VertexFormat::Float32x2;
+        }
+    }
+
+    constexpr auto get_vertex_attributes(const wga::vertex_format &format) -> std::array<WGPUVertexAttribute, 4> {
+        const WGPUVertexFormat formats[] = {
+                wga::get_wgpu_vertex_format(format.position),
+                wga::get_wgpu_vertex_format(format.normal),
+                wga::get_wgpu_vertex_format(format.color),
+                wga::get_wgpu_vertex_format(format.uv)};
+
+        std::array<WGPUVertexAttribute, 4> attributes{};
+        std::uint64_t offset = 0;
+        for (std::uint32_t location = 0; location < 4; ++location) {
+            attributes[location].shaderLocation = location; // @location(n)
+            attributes[location].format = formats[location];
+            attributes[location].offset = offset;
+            offset += wga::get_vertex_format_size(formats[location]);
+        }
+        return attributes;
+    }
+
+    constexpr auto get_vertex_stride(const wga::vertex_format &format) -> std::uint32_t {
+        const auto attributes = wga::get_vertex_attributes(format);
+        return static_cast<std::uint32_t>(attributes.back().offset) +
+               wga::get_vertex_format_size(attributes.back().format);
+    }
+
+    static_assert(wga::is_same_vertex_layout(wga::get_vertex_attributes(wga::full_vertex_format),
+                                             wga::vertex_layout<wga::shader_type::vertex_attributes>::attributes) &&
+                  wga::get_vertex_stride(wga::full_vertex_format) ==
+                  wga::vertex_layout<wga::shader_type::vertex_attributes>::stride,
+                  "The full vertex format must match wga::shader_type::vertex_attributes");
+
+    static_assert(wga::vertex_layout<wga::shader_type::vertex_position>::stride +
+                  wga::vertex_layout<wga::shader_type::vertex_surface>::stride ==
+                  wga::vertex_layout<wga::shader_type::vertex_attributes>::stride,
+                  "The split vertex streams must carry every attribute of wga::shader_type::vertex_attributes");
+
+    // Interleaved vertices to the position stream and the stream of everything else, see wga::create_depth_pipeline
+    auto split_vertex_streams(const std::vector<wga::shader_type::vertex_attributes> &vertex_data)
+    -> std::pair<std::vector<wga::shader_type::vertex_position>, std::vector<wga::shader_type::vertex_surface>> {
+        std::vector<wga::shader_type::vertex_position> positions(vertex_data.size());
+        std::vector<wga::shader_type::vertex_surface> surfaces(vertex_data.size());
+        for (std::size_t i = 0; i < vertex_data.size(); ++i) {
+            positions[i] = {vertex_data[i].position};
+            surfaces[i] = {vertex_data[i].normal, vertex_data[i].color, vertex_data[i].uv};
+        }
+        return {std::move(positions), std::move(surfaces)};
+    }
+
+    auto encode_octahedral(glm::vec3 normal) -> glm::vec2 {
+        const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length <= 0.0f) {
+            return glm::vec2(0.0f);
+        }
+        normal = normal / length;
+
+        if (normal.z >= 0.0f) {
+            return {normal.x, normal.y};
+        }
+        return {(1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f)};
+    }
+
+    // Maps positions to [0, 1] over the mesh bounds, the shader undoes it with us.position_offset/position_scale
+    auto get_position_quantization(glm::vec3 bounds_min, glm::vec3 bounds_max) -> std::pair<glm::vec3, glm::vec3> {
+        glm::vec3 extent = bounds_max - bounds_min;
+        for (int axis = 0; axis < 3; ++axis) {
+            extent[axis] = extent[axis] > 0.0f ? extent[axis] : 1.0f;
+        }
+        return {bounds_min, extent};
+    }
+
+    auto encode_vertices(const wga::vertex_format &format,
+                         const std::vector<wga::shader_type::vertex_attributes> &vertex_data,
+                         glm::vec3 bounds_min, glm::vec3 bounds_max) -> std::vector<std::byte> {
+        const auto attributes = wga::get_vertex_attributes(format);
+        const auto stride = wga::get_vertex_stride(format);
+        const auto [position_offset, position_scale] = wga::get_position_quantization(bounds_min, bounds_max);
+
+        std::vector<std::byte> encoded(vertex_data.size() * stride);
+        std::byte *out = encoded.data();
+
+        auto write = [&out](std::size_t attribute_offset, const auto &value) {
+            std::memcpy(out + attribute_offset, &value, sizeof(value));
+        };
+
+        for (const auto &vertex: vertex_data) {
+            if (format.position == wga::position_format::unorm16x4) {
+                const glm::vec3 quantized = (vertex.position - position_offset) / position_scale;
+                write(attributes[0].offset, glm::packUnorm4x16(glm::vec4(quantized, 0.0f)));
+            } else {
+                write(attributes[0].offset, vertex.position);
+            }
+
+            if (format.normal == wga::normal_format::octahedral_snorm16x2) {
+                write(attributes[1].offset, glm::packSnorm2x16(wga::encode_octahedral(vertex.normal)));
+            } else {
+                write(attributes[1].offset, vertex.normal);
+            }
+
+            if (format.color == wga::color_format::unorm8x4) {
+                write(attributes[2].offset, glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f)));
+            } else {
+                write(attributes[2].offset, vertex.color);
+            }
+
+            switch (format.uv) {
+                case wga::uv_format::float16x2:
+                    write(attributes[3].offset, glm::packHalf2x16(vertex.uv));
+                    break;
+                case wga::uv_format::unorm16x2:
+                    write(attributes[3].offset, glm::packUnorm2x16(vertex.uv));
+                    break;
+                default:
+                    write(attributes[3].offset, vertex.uv);
+                    break;
+            }
+
+            out += stride;
+        }
+
+        return encoded;
+    }
+
+    // WGSL vertex_input and instance_input structs and decode_vertex() for the format, prepended to the shader source
+    auto get_vertex_input_source(const wga::vertex_format &format) -> std::string {
+        const bool quantized_position = format.position == wga::position_format::unorm16x4;
+        const bool octahedral_normal = format.normal == wga::normal_format::octahedral_snorm16x2;
+        const bool packed_color = format.color == wga::color_format::unorm8x4;
+        // Field names come from the reflected vertex_attributes, types from the encoded formats
+        const auto &fields = wga::vertex_description<wga::shader_type::vertex_attributes>::attributes;
+        const auto attributes = wga::get_vertex_attributes(format);
+
+        std::string source = "struct vertex_input\n{\n";
+        for (std::size_t i = 0; i < attributes.size(); ++i) {
+            source += "    @location(" + std::to_string(attributes[i].shaderLocation) + ") ";
+            source += fields[i].name;
+            source += ": ";
+            source += wga::get_vertex_format_wgsl_type(attributes[i].format);
+            source += ",\n";
+        }
+        source += "};\n\n";
+
+        source += "struct instance_input\n{\n";
+        source += wga::get_vertex_input_fields<wga::shader_type::instance_attributes>();
+        source += "};\n\n";
+
+        if (octahedral_normal) {
+            source += R"(fn decode_octahedral(e: vec2f) -> vec3f
+{
+    var n = vec3f(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    let t = max(-n.z, 0.0);
+    n.x += select(t, -t, n.x >= 0.0);
+    n.y += select(t, -t, n.y >= 0.0);
+    return normalize(n);
+}
+
+)";
+        }
+
+        source += "fn decode_vertex(in: vertex_input) -> vertex\n{\n    var v: vertex;\n";
+        source += quantized_position ? "    v.position = us.position_offset.xyz + in.position.xyz * us.position_scale.xyz;\n"
+                                     : "    v.position = in.position;\n";
+        source += octahedral_normal ? "    v.normal = decode_octahedral(in.normal);\n"
+                                    : "    v.normal = in.normal;\n";
+        source += packed_color ? "    v.color = in.color.rgb;\n" : "    v.color = in.color;\n";
+        source += "    v.uv = in.uv;\n    return v;\n}\n\n";
+
+        return source;
+    }
+}
+
+#endif //WGA_VERTEX_FORMAT_HPP
@@ -0,0 +1,250 @@
+#ifndef WGA_VERTEX_LAYOUT_HPP
+#define WGA_VERTEX_LAYOUT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include <webgpu/webgpu.hpp>
+#include <glm/glm.hpp>
+
+// Compile time description of vertex structs, a struct is described once with WGA_VERTEX_ATTRIBUTE
+// and its wgpu attributes, stride and WGSL vertex_input fields are all derived from that description
+namespace wga {
+    // Throws for unknown formats, which fails compilation when called in a constant expression
+    constexpr auto get_vertex_format_size(WGPUVertexFormat format) -> std::uint32_t {
+        switch (format) {
+            case WGPUVertexFormat_Uint8x2:
+            case WGPUVertexFormat_Sint8x2:
+            case WGPUVertexFormat_Unorm8x2:
+            case WGPUVertexFormat_Snorm8x2:
+                return 2;
+            case WGPUVertexFormat_Uint8x4:
+            case WGPUVertexFormat_Sint8x4:
+            case WGPUVertexFormat_Unorm8x4:
+            case WGPUVertexFormat_Snorm8x4:
+            case WGPUVertexFormat_Uint16x2:
+            case WGPUVertexFormat_Sint16x2:
+            case WGPUVertexFormat_Unorm16x2:
+            case WGPUVertexFormat_Snorm16x2:
+            case WGPUVertexFormat_Float16x2:
+            case WGPUVertexFormat_Float32:
+            case WGPUVertexFormat_Uint32:
+            case WGPUVertexFormat_Sint32:
+                return 4;
+            case WGPUVertexFormat_Uint16x4:
+            case WGPUVertexFormat_Sint16x4:
+            case WGPUVertexFormat_Unorm16x4:
+            case WGPUVertexFormat_Snorm16x4:
+            case WGPUVertexFormat_Float16x4:
+            case WGPUVertexFormat_Float32x2:
+            case WGPUVertexFormat_Uint32x2:
+            case WGPUVertexFormat_Sint32x2:
+                return 8;
+            case WGPUVertexFormat_Float32x3:
+            case WGPUVertexFormat_Uint32x3:
+            case WGPUVertexFormat_Sint32x3:
+                return 12;
+            case WGPUVertexFormat_Float32x4:
+            case WGPUVertexFormat_Uint32x4:
+            case WGPUVertexFormat_Sint32x4:
+                return 16;
+            default:
+                throw std::invalid_argument("Unknown vertex format");
+        }
+    }
+
+    // WGSL type a vertex format is presented as in the shader, normalized formats read as floats
+    constexpr auto get_vertex_format_wgsl_type(WGPUVertexFormat format) -> std::string_view {
+        switch (format) {
+            case WGPUVertexFormat_Float32:
+                return "f32";
+            case WGPUVertexFormat_Unorm8x2:
+            case WGPUVertexFormat_Snorm8x2:
+            case WGPUVertexFormat_Unorm16x2:
+            case WGPUVertexFormat_Snorm16x2:
+            case WGPUVertexFormat_Float16x2:
+            case WGPUVertexFormat_Float32x2:
+                return "vec2f";
+            case WGPUVertexFormat_Float32x3:
+                return "vec3f";
+            case WGPUVertexFormat_Unorm8x4:
+            case WGPUVertexFormat_Snorm8x4:
+            case WGPUVertexFormat_Unorm16x4:
+            case WGPUVertexFormat_Snorm16x4:
+            case WGPUVertexFormat_Float16x4:
+            case WGPUVertexFormat_Float32x4:
+                return "vec4f";
+            case WGPUVertexFormat_Uint32:
+                return "u32";
+            case WGPUVertexFormat_Uint8x2:
+            case WGPUVertexFormat_Uint16x2:
+            case WGPUVertexFormat_Uint32x2:
+                return "vec2u";
+            case WGPUVertexFormat_Uint32x3:
+                return "vec3u";
+            case WGPUVertexFormat_Uint8x4:
+            case WGPUVertexFormat_Uint16x4:
+            case WGPUVertexFormat_Uint32x4:
+                return "vec4u";
+            case WGPUVertexFormat_Sint32:
+                return "i32";
+            case WGPUVertexFormat_Sint8x2:
+            case WGPUVertexFormat_Sint16x2:
+            case WGPUVertexFormat_Sint32x2:
+                return "vec2i";
+            case WGPUVertexFormat_Sint32x3:
+                return "vec3i";
+            case WGPUVertexFormat_Sint8x4:
+            case WGPUVertexFormat_Sint16x4:
+            case WGPUVertexFormat_Sint32x4:
+                return "vec4i";
+            default:
+                throw std::invalid_argument("Unknown vertex format");
+        }
+    }
+
+    template<typename T>
+    struct default_vertex_format;
+
+    template<>
+    struct default_vertex_format<float> {
+        static constexpr WGPUVertexFormat value = WGPUVertexFormat_Float32;
+    };
+
+    template<>
+    struct default_vertex_format<glm::vec2> {
+        static constexpr WGPUVertexFormat value = WGPUVertexFormat_Float32x2;
+    };
+
+    template<>
+    struct default_vertex_format<glm::vec3> {
+        static constexpr WGPUVertexFormat value = WGPUVertexFormat_Float32x3;
+    };
+
+    template<>
+    struct default_vertex_format<glm::vec4> {
+        static constexpr WGPUVertexFormat value = WGPUVertexFormat_Float32x4;
+    };
+
+    template<>
+    struct default_vertex_format<std::uint32_t> {
+        static constexpr WGPUVertexFormat value = WGPUVertexFormat_Uint32;
+    };
+
+    struct vertex_attribute_info {
+        std::string_view name;
+        WGPUVertexFormat format;
+        std::uint64_t offset;
+        std::uint32_t location;
+        std::size_t member_size;
+    };
+
+    // Specialize with `static constexpr std::array attributes{WGA_VERTEX_ATTRIBUTE(...), ...};`
+    template<typename Vertex>
+    struct vertex_description;
+
+#define WGA_VERTEX_ATTRIBUTE(vertex, member, location)                                              \
+    wga::vertex_attribute_info {                                                                    \
+        #member, wga::default_vertex_format<decltype(vertex::member)>::value, offsetof(vertex, member), \
+        location, sizeof(vertex::member)                                                            \
+    }
+
+#define WGA_VERTEX_ATTRIBUTE_AS(vertex, member, location, format)                  \
+    wga::vertex_attribute_info {                                                   \
+        #member, format, offsetof(vertex, member), location, sizeof(vertex::member) \
+    }
+
+    // WebGPU requires attribute offsets aligned to min(4, format size), and every attribute inside the stride
+    template<std::size_t N>
+    constexpr bool is_valid_vertex_layout(const std::array<wga::vertex_attribute_info, N> &attributes,
+                                          std::uint64_t stride) {
+        if (stride % 4 != 0) {
+            return false;
+        }
+        for (std::size_t i = 0; i < N; ++i) {
+            const auto size = wga::get_vertex_format_size(attributes[i].format);
+            if (attributes[i].member_size != size ||
+                attributes[i].offset % (size < 4 ? size : 4) != 0 ||
+                attributes[i].offset + size > stride) {
+                return false;
+            }
+            for (std::size_t j = 0; j < i; ++j) {
+                if (attributes[i].location == attributes[j].location) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template<typename Vertex>
+    struct vertex_layout {
+        static constexpr auto &description = wga::vertex_description<Vertex>::attributes;
+        static constexpr std::size_t attribute_count = std::tuple_size_v<std::decay_t<decltype(description)>>;
+        static constexpr std::uint64_t stride = sizeof(Vertex);
+
+        static_assert(wga::is_valid_vertex_layout(description, stride),
+                      "Vertex attribute formats, offsets or locations do not match the vertex struct");
+
+        static constexpr std::array<WGPUVertexAttribute, attribute_count> attributes = [] {
+            std::array<WGPUVertexAttribute, attribute_count> result{};
+            for (std::size_t i = 0; i < attribute_count; ++i) {
+                result[i].format = description[i].format;
+                result[i].offset = description[i].offset;
+                result[i].shaderLocation = description[i].location;
+            }
+            return result;
+        }();
+
+        static constexpr auto buffer_layout(WGPUVertexStepMode step_mode = WGPUVertexStepMode_Vertex) {
+            return WGPUVertexBufferLayout{stride, step_mode, attribute_count, attributes.data()};
+        }
+    };
+
+    // One vertex buffer per stream, e.g. a position only stream that depth passes can bind on its own
+    template<typename... Streams>
+    struct vertex_streams {
+        static constexpr std::array<WGPUVertexBufferLayout, sizeof...(Streams)> buffer_layouts{
+                wga::vertex_layout<Streams>::buffer_layout()...};
+    };
+
+    template<std::size_t N, std::size_t M>
+    constexpr bool is_same_vertex_layout(const std::array<WGPUVertexAttribute, N> &lhs,
+                                         const std::array<WGPUVertexAttribute, M> &rhs) {
+        if (N != M) {
+            return false;
+        }
+        for (std::size_t i = 0; i < N; ++i) {
+            if (lhs[i].format != rhs[i].format || lhs[i].offset != rhs[i].offset ||
+                lhs[i].shaderLocation != rhs[i].shaderLocation) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // WGSL vertex_input fields of the described streams, in location order of the description
+    template<typename... Streams>
+    auto get_vertex_input_fields() -> std::string {
+        std::string source;
+        auto append = [&source](const auto &description) {
+            for (const auto &attribute: description) {
+                source += "    @location(" + std::to_string(attribute.location) + ") ";
+                source += attribute.name;
+                source += ": ";
+                source += wga::get_vertex_format_wgsl_type(attribute.format);
+                source += ",\n";
+            }
+        };
+        (append(wga::vertex_description<Streams>::attributes), ...);
+        return source;
+    }
+}
+
+#endif //WGA_VERTEX_LAYOUT_HPP
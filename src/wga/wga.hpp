@@ -1,6 +1,8 @@
 #ifndef WGA_SRC_WGA_HPP
 #define WGA_SRC_WGA_HPP
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <optional>
@@ -14,6 +16,7 @@
 #include <webgpu/webgpu.hpp>
 #include <glfw3webgpu.h>
 
+#include <wga/object_policy.hpp>
 #include <wga/type_info.hpp>
 #include <wga/shaders.hpp>
 #include <wga/shader_types.hpp>
@@ -32,14 +35,15 @@ namespace wga {
         }
     };
 
-    template<typename T, bool Destroyable = false, bool Logging = true>
+    // Owns a wgpu handle, Policy adds bookkeeping such as live object counts, see wga/object_policy.hpp
+    template<typename T, bool Destroyable = false, typename Policy = wga::default_object_policy>
     struct object {
-        using U = wga::object<T, Destroyable, Logging>;
+        using U = wga::object<T, Destroyable, Policy>;
 
         explicit object(T &&t_data)
                 : data{std::forward<T>(t_data)} {
-            if constexpr (Logging) {
-                std::clog << "wga::object<" << wga::type_name(data) << ">(&&) " << t_data << '\n';
+            if (data.operator bool()) {
+                Policy::template on_create<T>();
             }
         }
 
@@ -48,50 +52,49 @@ namespace wga {
         auto operator=(const U &other) -> U & = delete;
 
         object(U &&other) noexcept : data(other.data) {
-            static_assert(sizeof(T) >= sizeof (std::size_t));
-            *reinterpret_cast<std::size_t*>(&other.data) = 0xBEAD5BEAD5;
+            other.data = T{};
         }
 
-        auto operator=(U &&other) noexcept -> U & = delete;
+        // Releases the held handle and takes over the one of other, e.g. to recreate a swapchain on resize
+        auto operator=(U &&other) noexcept -> U & {
+            if (this != &other) {
+                reset();
+                data = other.data;
+                other.data = T{};
+            }
+            return *this;
+        }
 
         ~object() {
-            if (*reinterpret_cast<std::size_t*>(&data) != 0xBEAD5BEAD5) {
-                if constexpr (Logging) {
-                    std::clog << "wga::object<" << wga::type_name(data) << ">~()\n";
-                }
-
-                if constexpr (Destroyable) {
-                    data.destroy();
-                }
-                data.release();
-            }else
-            {
-                if constexpr (Logging) {
-                    std::clog << "wga::object<" << wga::type_name(data) << ">~() of moved from object\n";
-                }
-            }
+            reset();
         }
 
         [[nodiscard]] auto &get() noexcept {
-            if (*reinterpret_cast<std::size_t*>(&data) == 0xBEAD5BEAD5)
-            {
-                std::cerr << "Use of deleted object!\n";
-            }
             return data;
         }
 
         [[maybe_unused]] [[nodiscard]] const auto &get() const noexcept {
-            if (*reinterpret_cast<std::size_t*>(&data) == 0xBEAD5BEAD5)
-            {
-                std::cerr << "Use of deleted object!\n";
-            }
             return data;
         }
 
     private:
+        void reset() noexcept {
+            // Moved from objects hold a null handle
+            if (data.operator bool()) {
+                Policy::template on_destroy<T>();
+                if constexpr (Destroyable) {
+                    data.destroy();
+                }
+                data.release();
+                data = T{};
+            }
+        }
+
         T data;
     };
 
+    static_assert(sizeof(wga::object<wgpu::Buffer, true, wga::release_policy>) == sizeof(wgpu::Buffer));
+
     auto on_device_error(wgpu::ErrorType type, const char *message) {
         std::cerr << "Uncaptured device error: type " << type;
         if (message) {
@@ -149,9 +152,10 @@ namespace wga {
         return wga::object<wgpu::Surface>{{glfwGetWGPUSurface(instance.get(), window)}};
     }
 
-    auto request_adapter(wga::object<wgpu::Instance> &instance, wga::object<wgpu::Surface> &surface) {
+    auto request_adapter(wga::object<wgpu::Instance> &instance,
+                         const wgpu::RequestAdapterOptions &options) -> std::optional<wgpu::Adapter> {
         std::optional<wgpu::Adapter> result;
-        const char *result_message;
+        const char *result_message = nullptr;
         auto on_adapter_request_ended =
                 [&result, &result_message](wgpu::RequestAdapterStatus status, wgpu::Adapter adapter,
                                            const char *message) {
@@ -163,50 +167,101 @@ namespace wga {
                     result_message = message;
                 };
 
+        instance.get().requestAdapter(options, on_adapter_request_ended);
+
+        if (!result) {
+            std::cerr << "Could not get WebGPU adapter: " << (result_message ? result_message : "") << '\n';
+        }
+        return result;
+    }
+
+    auto request_adapter(wga::object<wgpu::Instance> &instance, wga::object<wgpu::Surface> &surface) {
         wgpu::RequestAdapterOptions options{};
         options.compatibleSurface = surface.get();
-        instance.get().requestAdapter(options, on_adapter_request_ended);
 
+        auto result = wga::request_adapter(instance, options);
         if (!result) {
-            std::cerr << "Could not get WebGPU adapter: " << result_message << '\n';
             throw std::runtime_error("Could not get WebGPU adapter!");
         }
 
         return wga::object<wgpu::Adapter>{std::forward<wgpu::Adapter>(result.value())};
     }
 
-    [[maybe_unused]] auto get_adapter_features(wga::object<wgpu::Adapter> &adapter) {
+    // Adapter without a surface, falls back to a software adapter (llvmpipe, lavapipe) on machines without a GPU
+    auto request_headless_adapter(wga::object<wgpu::Instance> &instance) {
+        wgpu::RequestAdapterOptions options{};
+        options.compatibleSurface = nullptr;
+
+        auto result = wga::request_adapter(instance, options);
+        if (!result) {
+            std::clog << "Requesting a fallback adapter\n";
+            options.forceFallbackAdapter = true;
+            result = wga::request_adapter(instance, options);
+        }
+        if (!result) {
+            throw std::runtime_error("Could not get WebGPU adapter!");
+        }
+
+        return wga::object<wgpu::Adapter>{std::forward<wgpu::Adapter>(result.value())};
+    }
+
+    auto get_adapter_features(wga::object<wgpu::Adapter> &adapter) {
         auto feature_count = adapter.get().enumerateFeatures(nullptr);
         std::vector<wgpu::FeatureName> features(feature_count, wgpu::FeatureName::Undefined);
         adapter.get().enumerateFeatures(features.data());
         return features;
     }
 
-    auto get_device(wga::object<wgpu::Adapter> &adapter) {
+    auto has_feature(const std::vector<wgpu::FeatureName> &features, wgpu::FeatureName feature) -> bool {
+        return std::any_of(features.begin(), features.end(), [feature](wgpu::FeatureName candidate) {
+            return static_cast<WGPUFeatureName>(candidate) == static_cast<WGPUFeatureName>(feature);
+        });
+    }
+
+    auto get_device(wga::object<wgpu::Adapter> &adapter, std::uint64_t min_buffer_size = 0) {
         wgpu::SupportedLimits supported_limits;
         adapter.get().getLimits(&supported_limits);
 
         wgpu::RequiredLimits required_limits = wgpu::Default;
-        required_limits.limits.maxVertexAttributes = 4;
-        required_limits.limits.maxVertexBuffers = 1;
-        required_limits.limits.maxBufferSize = 10000 * sizeof(wga::shader_type::vertex_attributes);
-        required_limits.limits.maxVertexBufferArrayStride = sizeof(wga::shader_type::vertex_attributes);
+        required_limits.limits.maxVertexAttributes = static_cast<std::uint32_t>(
+                wga::vertex_description<wga::shader_type::vertex_attributes>::attributes.size() +
+                wga::vertex_description<wga::shader_type::instance_attributes>::attributes.size());
+        required_limits.limits.maxVertexBuffers = 2; // vertex and instance stream
+        // Meshes share large arena buffers, so ask for as much as the adapter allows
+        if (supported_limits.limits.maxBufferSize < min_buffer_size) {
+            std::cerr << "Adapter maxBufferSize " << supported_limits.limits.maxBufferSize << " is below the required "
+                      << min_buffer_size << '\n';
+            throw std::runtime_error("Adapter buffer size limit too low");
+        }
+        required_limits.limits.maxBufferSize = supported_limits.limits.maxBufferSize;
+        required_limits.limits.maxVertexBufferArrayStride = static_cast<std::uint32_t>(std::max(
+                sizeof(wga::shader_type::vertex_attributes), sizeof(wga::shader_type::instance_attributes)));
         required_limits.limits.minStorageBufferOffsetAlignment = supported_limits.limits.minStorageBufferOffsetAlignment;
         required_limits.limits.minUniformBufferOffsetAlignment = supported_limits.limits.minUniformBufferOffsetAlignment;
-        required_limits.limits.maxInterStageShaderComponents = 8;
+        // color, normal, uv and the flat texture layer
+        required_limits.limits.maxInterStageShaderComponents = 9;
         required_limits.limits.maxBindGroups = 1;
         required_limits.limits.maxUniformBuffersPerShaderStage = 1;
         required_limits.limits.maxUniformBufferBindingSize = 16 * 4 * sizeof(float);
         required_limits.limits.maxDynamicUniformBuffersPerPipelineLayout = 1;
-        required_limits.limits.maxTextureDimension1D = 480;
-        required_limits.limits.maxTextureDimension2D = 640;
-        required_limits.limits.maxTextureArrayLayers = 1;
+        // The swapchain follows the framebuffer and textures keep their image size, see wga::resize
+        required_limits.limits.maxTextureDimension1D = supported_limits.limits.maxTextureDimension1D;
+        required_limits.limits.maxTextureDimension2D = supported_limits.limits.maxTextureDimension2D;
+        // Material textures share one texture array, see wga::material_textures
+        required_limits.limits.maxTextureArrayLayers = supported_limits.limits.maxTextureArrayLayers;
         required_limits.limits.maxSampledTexturesPerShaderStage = 1;
 
+        // Optional features are only requested when the adapter has them, callers check the device, e.g.
+        // wga::supports_block_compression
+        std::vector<WGPUFeatureName> required_features;
+        if (wga::has_feature(wga::get_adapter_features(adapter), wgpu::FeatureName::TextureCompressionBC)) {
+            required_features.push_back(WGPUFeatureName_TextureCompressionBC);
+        }
+
         wgpu::DeviceDescriptor device_descriptor = wgpu::Default;
         device_descriptor.label = "My Device";
-        device_descriptor.requiredFeaturesCount = 0;
-        device_descriptor.requiredFeatures = nullptr;
+        device_descriptor.requiredFeaturesCount = required_features.size();
+        device_descriptor.requiredFeatures = required_features.data();
         device_descriptor.defaultQueue.label = "The default queue";
         device_descriptor.requiredLimits = &required_limits;
 
@@ -234,24 +289,36 @@ namespace wga {
         return wga::object<wgpu::Device>{std::forward<wgpu::Device>(result.value())};
     }
 
+    // Runs pending callbacks such as buffer map results. Only wgpu-native can block until the queue is idle, Dawn just
+    // processes what has completed, so callers poll in a loop until their callback ran
+    void poll(wga::object<wgpu::Device> &device, bool wait) {
+#if defined(WEBGPU_BACKEND_DAWN)
+        static_cast<void>(wait);
+        device.get().tick();
+#else
+        device.get().poll(wait, nullptr);
+#endif
+    }
+
     auto get_swapchain_format(wga::object<wgpu::Surface> &surface, wga::object<wgpu::Adapter> &adapter) {
         return surface.get().getPreferredFormat(adapter.get());
     }
 
     auto create_swapchain(wga::object<wgpu::Surface> &surface, wga::object<wgpu::Adapter> &adapter,
                           wga::object<wgpu::Device> &device,
-                          std::uint32_t width, std::uint32_t height) {
+                          std::uint32_t width, std::uint32_t height,
+                          wgpu::PresentMode present_mode = wgpu::PresentMode::Fifo) {
         wgpu::SwapChainDescriptor swapchain_desc = wgpu::Default;
         swapchain_desc.width = width;
         swapchain_desc.height = height;
         swapchain_desc.format = get_swapchain_format(surface, adapter);
         swapchain_desc.usage = WGPUTextureUsage_RenderAttachment;
-        swapchain_desc.presentMode = WGPUPresentMode_Fifo;
+        swapchain_desc.presentMode = present_mode;
 
         return wga::object<wgpu::SwapChain>{device.get().createSwapChain(surface.get(), swapchain_desc)};
     }
 
-    auto create_shader_module(const std::filesystem::path &path, wga::object<wgpu::Device> &device) {
+    auto read_shader_source(const std::filesystem::path &path) {
         std::ifstream stream(path);
         if (!stream) {
             throw std::runtime_error("Could not load shader file: " + path.string());
@@ -259,8 +326,10 @@ namespace wga {
 
         std::stringstream ss;
         ss << stream.rdbuf();
-        std::string source = ss.str();
+        return ss.str();
+    }
 
+    auto create_shader_module(const std::string &source, wga::object<wgpu::Device> &device) {
         wgpu::ShaderModuleWGSLDescriptor wgsl_desc;
         wgsl_desc.chain.next = nullptr;
         wgsl_desc.chain.sType = wgpu::SType::ShaderModuleWGSLDescriptor;
@@ -276,15 +345,35 @@ namespace wga {
         return wga::object<wgpu::ShaderModule>{device.get().createShaderModule(shader_module_desc)};
     }
 
-    auto create_buffer(wga::object<wgpu::Device> &device, std::uint64_t size, wgpu::BufferUsageFlags usage) {
+    auto create_shader_module(const std::filesystem::path &path, wga::object<wgpu::Device> &device) {
+        return wga::create_shader_module(wga::read_shader_source(path), device);
+    }
+
+    auto create_buffer(wga::object<wgpu::Device> &device, std::uint64_t size, wgpu::BufferUsageFlags usage,
+                       bool mapped_at_creation = false) {
         wgpu::BufferDescriptor desc;
         desc.label = "Buffer\n";
         desc.usage = usage;
         desc.size = size;
-        desc.mappedAtCreation = false;
+        desc.mappedAtCreation = mapped_at_creation;
         return wga::object<wgpu::Buffer, true>{device.get().createBuffer(desc)};
     }
 
+    // Creates a buffer mapped at creation and copies data straight into it, without a queue.writeBuffer staging copy
+    auto create_buffer_init(wga::object<wgpu::Device> &device, const void *data, std::uint64_t size,
+                            wgpu::BufferUsageFlags usage) {
+        // Mapped buffers must have a size that is a multiple of 4
+        const std::uint64_t mapped_size = (size + 3) / 4 * 4;
+        auto buffer = wga::create_buffer(device, mapped_size, usage, true);
+
+        auto *mapped = static_cast<char *>(buffer.get().getMappedRange(0, static_cast<std::size_t>(mapped_size)));
+        std::memcpy(mapped, data, static_cast<std::size_t>(size));
+        std::memset(mapped + size, 0, static_cast<std::size_t>(mapped_size - size));
+        buffer.get().unmap();
+
+        return buffer;
+    }
+
     auto get_uniform_buffer_stride(wga::object<wgpu::Device> &device) {
         wgpu::SupportedLimits supported_limits;
         device.get().getLimits(&supported_limits);